@@ -0,0 +1,151 @@
+"""
+bench.py — replay games through GameManager on the simulated board (sim.py).
+
+    python bench.py                       # built-in game
+    python bench.py games.txt --poll      # one game per line, UCI moves
+
+The player has White and makes the odd moves by hand (SimRig.player_move);
+the computer's replies come from the file instead of Stockfish and run
+on the simulated gantry. Reported per game and overall:
+
+    detect    from the player's last piece touching down to the move
+              being returned by detect_player_move()
+    polls     requests sent to the Nanos while detecting one move
+    pushes    blocks the Nanos pushed meanwhile (stream mode)
+    planner   plan_move() per computer move
+    decode    decode_board() throughput over random block pairs
+
+Run from the directory with config.yaml, as manager.py.
+"""
+
+import argparse
+import os
+import statistics
+import sys
+import threading
+import time
+
+import chess
+
+import console
+import manager
+from manager import GameManager, decode_board
+from motion import plan_move
+from sim import IdleEngine, SimRig
+
+DEFAULT_GAME = "e2e4 e7e5 g1f3 b8c6 f1c4 g8f6 e1g1 f6e4 d2d3 e4f6 f3e5 c6e5"
+DECODE_ITERATIONS = 100_000
+PLAYER_START_DELAY_S = 0.3   # the board holds still this long before each player move
+
+
+def load_games(path):
+    if path is None:
+        return [DEFAULT_GAME.split()]
+    with open(path) as f:
+        return [line.split() for line in f if line.strip() and not line.startswith("#")]
+
+
+def report(name, values, unit, scale=1.0):
+    if not values:
+        print(f"  {name:<8} -")
+        return
+    v = [x * scale for x in values]
+    print(f"  {name:<8} n={len(v):<4} mean {statistics.mean(v):8.2f} {unit}"
+          f"  median {statistics.median(v):8.2f}  max {max(v):8.2f}")
+
+
+def play_game(moves, args):
+    rig = SimRig(chess.Board(), latency_ms=args.latency_ms, scan_ms=args.scan_ms,
+                 flicker=args.flicker, miss=args.miss, seed=args.seed)
+    gm = GameManager(None, ports=rig.ports, engine=IdleEngine(), label="sim")
+    stats = {"detect": [], "polls": [], "pushes": [], "planner": [], "missed": 0}
+    try:
+        if not gm.start_game():
+            raise Exception("initial board not recognised")
+
+        for ply, uci in enumerate(moves):
+            mv = chess.Move.from_uci(uci)
+            if mv not in gm.board.legal_moves:
+                raise Exception(f"ply {ply + 1}: {uci} is not legal in {gm.board.fen()}")
+
+            if ply % 2 == 0:
+                gm.cache_legal_moves()
+                placed = []
+                hand = threading.Thread(target=lambda: (time.sleep(PLAYER_START_DELAY_S),
+                                                        placed.append(rig.player_move(gm.board, mv))))
+                before, pushed = rig.requests, rig.pushes
+                hand.start()
+                detected = None
+                while detected is None:
+                    detected = gm.detect_player_move()
+                done = time.monotonic()
+                hand.join()
+                if detected != uci:
+                    stats["missed"] += 1
+                    raise Exception(f"ply {ply + 1}: played {uci}, detected {detected}")
+                stats["detect"].append(done - placed[0])
+                stats["polls"].append(rig.requests - before)
+                stats["pushes"].append(rig.pushes - pushed)
+                gm.push_move(mv)
+            else:
+                t0 = time.perf_counter()
+                plan_move(mv, gm.board, gm.graveyard, head=gm.head or gm.head_guess)
+                stats["planner"].append(time.perf_counter() - t0)
+                if not gm.play_computer_move(mv):
+                    raise Exception(f"ply {ply + 1}: {uci} not confirmed on the board")
+    finally:
+        gm.quit()
+    return stats
+
+
+def bench_decode(n=DECODE_ITERATIONS):
+    pairs = [(os.urandom(manager.BLOCK_BYTES), os.urandom(manager.BLOCK_BYTES)) for _ in range(64)]
+    t0 = time.perf_counter()
+    for i in range(n):
+        left, right = pairs[i & 63]
+        decode_board(left, right)
+    return n / (time.perf_counter() - t0)
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__.split("\n")[1])
+    ap.add_argument("games", nargs="?", help="file with one game per line (UCI, White first)")
+    ap.add_argument("--poll", action="store_true", help="poll the Nanos instead of streaming")
+    ap.add_argument("--latency-ms", type=float, default=2.0, help="per request")
+    ap.add_argument("--scan-ms", type=float, default=1.0, help="per reader channel scanned")
+    ap.add_argument("--flicker", type=float, default=0.0, help="chance a read is a wrong piece")
+    ap.add_argument("--miss", type=float, default=0.0, help="chance a reader is not read")
+    ap.add_argument("--seed", type=int, default=0)
+    args = ap.parse_args()
+
+    manager.STREAM_MODE = not args.poll
+
+    totals = {"detect": [], "polls": [], "pushes": [], "planner": []}
+    failed = 0
+    for i, moves in enumerate(load_games(args.games)):
+        print(f"\n#### game {i + 1}: {len(moves)} plies")
+        try:
+            stats = play_game(moves, args)
+        except Exception as e:
+            print(f"[bench] game {i + 1} failed: {e}")
+            failed += 1
+            continue
+        for k in totals:
+            totals[k] += stats[k]
+
+    console.drain()
+    print("\n==== bench ====")
+    print(f"  mode     {'poll' if args.poll else 'stream'}, latency {args.latency_ms} ms, "
+          f"scan {args.scan_ms} ms/channel, flicker {args.flicker}, miss {args.miss}")
+    report("detect", totals["detect"], "ms", 1000.0)
+    report("polls", totals["polls"], "req")
+    report("pushes", totals["pushes"], "blk")
+    report("planner", totals["planner"], "ms", 1000.0)
+    print(f"  decode   {bench_decode():,.0f} boards/s")
+    if failed:
+        print(f"  {failed} game(s) failed")
+        sys.exit(1)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,116 @@
+"""
+console.py — levelled log output, written by a background thread.
+
+Every module logs through logger(name); records go onto a bounded queue
+and one listener thread formats and writes them, so a slow SSH or serial
+terminal never holds up a Nano read or a move confirmation. Arguments
+are formatted on the listener too: pass render-on-demand objects such as
+deferred(pretty_board, board) rather than pre-built strings.
+
+From the `log:` section of config.yaml:
+
+    log:
+      level: info        # debug adds board diagrams and every motion packet
+      file: game.log     # optional; the terminal otherwise
+      format: "%(asctime)s %(levelname)s %(name)s: %(message)s"
+
+If the queue is full (the terminal cannot keep up) records are dropped
+and counted, never waited for.
+"""
+
+from __future__ import annotations
+
+import atexit
+import logging
+import logging.handlers
+import queue
+import sys
+
+ROOT = "chessmanager"
+QUEUE_SIZE = 10_000
+DEFAULT_FORMAT = "%(message)s"
+LEVELS = ("debug", "info", "warning", "error")
+
+
+def logger(name):
+    return logging.getLogger(f"{ROOT}.{name}")
+
+
+class deferred:
+    """fn(*args), called only when a record that uses it is written."""
+
+    __slots__ = ("fn", "args")
+
+    def __init__(self, fn, *args):
+        self.fn = fn
+        self.args = args
+
+    def __str__(self):
+        return str(self.fn(*self.args))
+
+
+class _DroppingQueueHandler(logging.handlers.QueueHandler):
+    def __init__(self, q):
+        super().__init__(q)
+        self.dropped = 0
+
+    def prepare(self, record):
+        # Formatting happens on the listener; exceptions are rendered
+        # here, since their frames may not outlive the call
+        if record.exc_info:
+            record.exc_text = logging.Formatter().formatException(record.exc_info)
+            record.exc_info = None
+        return record
+
+    def enqueue(self, record):
+        try:
+            self.queue.put_nowait(record)
+        except queue.Full:
+            self.dropped += 1
+
+
+_handler = None
+_listener = None
+
+
+def setup(cfg):
+    """Route every logger(name) through the background writer, once."""
+    global _handler, _listener
+    cfg = cfg or {}
+    level = str(cfg.get("level", "info")).lower()
+    if level not in LEVELS:
+        raise Exception(f"log.level must be one of {', '.join(LEVELS)}, got {level!r}")
+
+    root = logging.getLogger(ROOT)
+    root.setLevel(level.upper())
+    if _handler is not None:
+        return
+
+    path = cfg.get("file")
+    out = logging.FileHandler(path) if path else logging.StreamHandler(sys.stdout)
+    out.setFormatter(logging.Formatter(cfg.get("format", DEFAULT_FORMAT)))
+
+    _handler = _DroppingQueueHandler(queue.Queue(QUEUE_SIZE))
+    _listener = logging.handlers.QueueListener(_handler.queue, out)
+    root.addHandler(_handler)
+    root.propagate = False
+    _listener.start()
+    atexit.register(shutdown)
+
+
+def drain():
+    """Block until everything logged so far has been written."""
+    if _listener is not None:
+        _handler.queue.join()
+
+
+def shutdown():
+    """Write out what is queued and stop the writer thread."""
+    global _listener
+    if _listener is None:
+        return
+    _listener.stop()
+    _listener = None
+    if _handler.dropped:
+        print(f"[log] {_handler.dropped} records dropped, output could not keep up",
+              file=sys.stderr)
@@ -0,0 +1,576 @@
+"""
+engine.py — Stockfish wrapper with pondering.
+
+The engine never sits idle between computer moves:
+
+    1. play() returns the computer's move and the reply the engine expects.
+    2. start_ponder() immediately searches the position after that expected
+       reply, in the background, while the gantry moves and the player
+       thinks.
+    3. On the next play(), if the player made the expected reply, the
+       running search is topped up to the search limit and its best move is
+       used; otherwise it is stopped and a fresh search runs.
+
+Before any search, play() asks a MoveBook: an optional Polyglot opening
+book, then a persistent cache of earlier search results for the same
+position and search budget. Either answers without touching Stockfish.
+
+manager.py only calls play(), start_ponder() and quit().
+
+With an EnginePool (server.py, several boards in one process) the games
+share a fixed set of Stockfish processes instead of one each. Jobs carry
+a priority (live moves before pondering), an optional deadline and a
+cancellable flag; within a priority boards are served round-robin. A
+move that waits more than MOVE_QUEUE_WAIT × its move time for an engine
+is played from a shallow QUICK_DEPTH search instead.
+
+Search budget and engine options come from the `engine:` section of
+config.yaml (see README), e.g.
+
+    engine:
+      threads: 4          # Stockfish Threads
+      hash: 128           # Stockfish Hash, MB
+      limit:              # any of time (s), depth, nodes
+        time: 0.1
+      clock:              # optional; replaces `limit` with clock-aware search
+        base: 300         # seconds on the computer's clock
+        increment: 2      # seconds added after each computer move
+      book: books/gm2001.bin       # optional Polyglot opening book
+      cache: positions.jsonl       # optional position → best move cache
+"""
+
+from __future__ import annotations
+
+import collections
+import json
+import os
+import threading
+import time
+from concurrent.futures import CancelledError, Future, ThreadPoolExecutor
+
+import chess
+import chess.engine
+import chess.polyglot
+
+import console
+
+log = console.logger("engine")
+
+DEFAULT_MOVE_TIME = 0.1
+MOVES_TO_GO = 30          # clock mode: share of the clock a move may plan for
+PONDER_TICK_S = 0.01      # poll interval while a pondered search catches up
+PONDER_TOPUP_MAX_S = 1.0  # give up waiting for depth/nodes after this long
+# Pool: a move search that has not found a free engine within
+# MOVE_QUEUE_WAIT × move_time() is dropped for a QUICK_DEPTH search, so
+# a busy pool costs the board playing strength rather than more waiting
+MOVE_QUEUE_WAIT = 2.0
+QUICK_DEPTH = 8
+
+
+# --------------------------------------------------
+# Search budget
+# --------------------------------------------------
+class SearchBudget:
+    """
+    Builds the chess.engine.Limit for each computer move. In clock mode
+    the computer's own clock is charged with the time each search takes,
+    so the engine paces itself over the game.
+    """
+
+    def __init__(self, time=None, depth=None, nodes=None, clock=None, increment=0.0):
+        if clock is None and time is None and depth is None and nodes is None:
+            time = DEFAULT_MOVE_TIME
+        self.time = time
+        self.depth = depth
+        self.nodes = nodes
+        self.clock = clock
+        self.increment = increment
+
+    @classmethod
+    def from_config(cls, cfg):
+        cfg = cfg or {}
+        limit = cfg.get("limit") or {}
+        clock = cfg.get("clock") or {}
+        unknown = set(limit) - {"time", "depth", "nodes"} | set(clock) - {"base", "increment"}
+        if unknown:
+            raise Exception(f"Unknown engine search settings in config.yaml: {sorted(unknown)}")
+        return cls(time=limit.get("time"), depth=limit.get("depth"), nodes=limit.get("nodes"),
+                   clock=clock.get("base"), increment=clock.get("increment", 0.0))
+
+    def limit(self):
+        if self.clock is not None:
+            # Both clocks show the computer's time; the player is not timed
+            return chess.engine.Limit(white_clock=self.clock, black_clock=self.clock,
+                                      white_inc=self.increment, black_inc=self.increment)
+        return chess.engine.Limit(time=self.time, depth=self.depth, nodes=self.nodes)
+
+    def move_time(self):
+        """Seconds a pondered search must have run before it is used."""
+        if self.clock is not None:
+            return self.clock / MOVES_TO_GO + self.increment
+        return self.time or 0.0
+
+    def satisfied_by(self, info):
+        """Whether a background search's latest info meets the depth/nodes limit."""
+        if self.depth is not None and info.get("depth", 0) < self.depth:
+            return False
+        if self.nodes is not None and info.get("nodes", 0) < self.nodes:
+            return False
+        return True
+
+    def key(self):
+        """Identifies the budget in the position cache; None if results depend on the clock."""
+        if self.clock is not None:
+            return None
+        return f"time={self.time},depth={self.depth},nodes={self.nodes}"
+
+    def charge(self, elapsed):
+        if self.clock is not None:
+            self.clock = max(0.0, self.clock - elapsed) + self.increment
+
+
+def engine_options(cfg):
+    """UCI options from config.yaml's engine section."""
+    cfg = cfg or {}
+    options = {}
+    if cfg.get("threads") is not None:
+        options["Threads"] = int(cfg["threads"])
+    if cfg.get("hash") is not None:
+        options["Hash"] = int(cfg["hash"])
+    return options
+
+
+# --------------------------------------------------
+# MoveBook — answers before the engine is asked
+# --------------------------------------------------
+class MoveBook:
+    """
+    Polyglot opening book plus an append-only JSON-lines cache of
+    position → (best move, expected reply) for a given search budget.
+    The cache is loaded once at startup; every new result is appended.
+    """
+
+    def __init__(self, book_path=None, cache_path=None):
+        self.reader = chess.polyglot.open_reader(book_path) if book_path else None
+        self.cache_path = cache_path
+        self.cache = {}
+        if cache_path and os.path.exists(cache_path):
+            with open(cache_path, "r") as f:
+                for line in f:
+                    try:
+                        entry = json.loads(line)
+                        self.cache[entry["key"]] = (entry["move"], entry.get("ponder"))
+                    except (ValueError, KeyError):
+                        continue   # torn last line from an interrupted run
+
+    @classmethod
+    def from_config(cls, cfg):
+        cfg = cfg or {}
+        return cls(cfg.get("book"), cfg.get("cache"))
+
+    @staticmethod
+    def _key(board, budget_key):
+        return f"{board.epd()}|{budget_key}"
+
+    def lookup(self, board, budget_key):
+        if self.reader is not None:
+            entry = self.reader.get(board)
+            if entry is not None:
+                return entry.move, None
+
+        if budget_key is None:
+            return None
+        hit = self.cache.get(self._key(board, budget_key))
+        if hit is None:
+            return None
+        move = chess.Move.from_uci(hit[0])
+        if move not in board.legal_moves:
+            return None
+        ponder = chess.Move.from_uci(hit[1]) if hit[1] else None
+        return move, ponder
+
+    def store(self, board, budget_key, move, ponder):
+        if self.cache_path is None or budget_key is None or move is None:
+            return
+        key = self._key(board, budget_key)
+        entry = (move.uci(), ponder.uci() if ponder else None)
+        if self.cache.get(key) == entry:
+            return
+        self.cache[key] = entry
+        with open(self.cache_path, "a") as f:
+            f.write(json.dumps({"key": key, "move": entry[0], "ponder": entry[1]}) + "\n")
+
+    def close(self):
+        if self.reader is not None:
+            self.reader.close()
+
+
+# --------------------------------------------------
+# EnginePool — Stockfish processes shared by several games
+# --------------------------------------------------
+PRIORITY_MOVE     = 0   # a board is waiting for the computer's move
+PRIORITY_PONDER   = 1   # background search on the expected reply
+
+
+class PoolJob:
+    """
+    One queued engine job. fn(engine, job) runs on a pool engine; a
+    cancellable job polls job.should_stop() and returns what it has as
+    soon as it is set (cancelled, pre-empted or past its deadline).
+    """
+
+    def __init__(self, owner, fn, priority, deadline, cancellable):
+        self.owner = owner
+        self.fn = fn
+        self.priority = priority
+        self.deadline = deadline          # time.monotonic(); None = none
+        self.cancellable = cancellable
+        self.future = Future()
+        self.stopped = threading.Event()
+        self.preempted = False
+        self.started = None
+        self.info = {}                    # latest search info, for pondering
+
+    def expired(self):
+        return self.deadline is not None and time.monotonic() >= self.deadline
+
+    def should_stop(self):
+        return self.stopped.is_set() or self.expired()
+
+    def cancel(self):
+        """Drop the job if still queued; ask it to stop if running."""
+        if not self.future.cancel():
+            self.stopped.set()
+
+    def result(self, timeout=None):
+        return self.future.result(timeout)
+
+
+class EnginePool:
+    """
+    Fixed set of engine processes, one worker thread each. The most
+    urgent priority is served first; within a priority, jobs are queued
+    per owner (one per board) and owners are served round-robin, so a
+    board with several queued searches cannot starve the others.
+
+    A job that is not started by its deadline fails with TimeoutError.
+    When every engine is busy, a new job pre-empts the least urgent
+    running cancellable job of lower priority, so a live move never
+    waits behind another board's pondering.
+    """
+
+    def __init__(self, engine_path, size=1, options=None):
+        # Spawned side by side: each engine's startup is mostly waiting
+        with ThreadPoolExecutor(max_workers=size) as ex:
+            self.engines = list(ex.map(lambda _: chess.engine.SimpleEngine.popen_uci(engine_path),
+                                       range(size)))
+        for engine in self.engines:
+            if options:
+                engine.configure(options)
+
+        self._cond = threading.Condition()
+        self._queues = {}           # priority -> OrderedDict(owner -> deque of PoolJob)
+        self._running = set()
+        self._closed = False
+        self.preemptions = 0
+        self.expired = 0
+        self._workers = [threading.Thread(target=self._worker, args=(engine,),
+                                          name=f"engine-{i}", daemon=True)
+                         for i, engine in enumerate(self.engines)]
+        for t in self._workers:
+            t.start()
+
+    def submit(self, owner, fn, priority=PRIORITY_MOVE, deadline=None, cancellable=False):
+        job = PoolJob(owner, fn, priority, deadline, cancellable)
+        with self._cond:
+            if self._closed:
+                raise RuntimeError("engine pool is closed")
+            queues = self._queues.setdefault(priority, collections.OrderedDict())
+            queues.setdefault(owner, collections.deque()).append(job)
+            self._preempt_for(job)
+            self._cond.notify()
+        return job
+
+    def run(self, owner, fn, **kw):
+        return self.submit(owner, fn, **kw).result()
+
+    def _preempt_for(self, job):
+        if len(self._running) < len(self.engines):
+            return
+        victims = [r for r in self._running
+                   if r.cancellable and r.priority > job.priority and not r.stopped.is_set()]
+        if victims:
+            victim = max(victims, key=lambda r: r.priority)
+            victim.preempted = True
+            victim.stopped.set()
+            self.preemptions += 1
+
+    def _pop_job(self):
+        for priority in sorted(self._queues):
+            queues = self._queues[priority]
+            while queues:
+                owner, queue = next(iter(queues.items()))
+                job = queue.popleft()
+                if queue:
+                    queues.move_to_end(owner)
+                else:
+                    del queues[owner]
+                if job.future.cancelled():
+                    continue
+                if job.expired():
+                    self.expired += 1
+                    job.future.set_exception(TimeoutError("engine job deadline passed before it started"))
+                    continue
+                return job
+        return None
+
+    def _next_job(self):
+        with self._cond:
+            while True:
+                job = self._pop_job()
+                if job is not None or self._closed:
+                    if job is not None:
+                        self._running.add(job)
+                    return job
+                self._cond.wait()
+
+    def _worker(self, engine):
+        while True:
+            job = self._next_job()
+            if job is None:
+                return
+            try:
+                if not job.future.set_running_or_notify_cancel():
+                    continue
+                job.started = time.monotonic()
+                try:
+                    job.future.set_result(job.fn(engine, job))
+                except Exception as e:
+                    job.future.set_exception(e)
+            finally:
+                with self._cond:
+                    self._running.discard(job)
+
+    def close(self):
+        with self._cond:
+            self._closed = True
+            for queues in self._queues.values():
+                for queue in queues.values():
+                    for job in queue:
+                        job.future.cancel()
+            self._queues.clear()
+            for job in self._running:
+                job.stopped.set()
+            self._cond.notify_all()
+        for t in self._workers:
+            t.join()
+        for engine in self.engines:
+            engine.quit()
+
+
+def _pool_ponder(target):
+    """Pool job: analyse `target` until stopped; returns the BestMove."""
+    def run(engine, job):
+        with engine.analysis(target) as analysis:
+            while not job.should_stop():
+                job.info = analysis.info
+                job.stopped.wait(PONDER_TICK_S)
+            job.info = analysis.info
+            analysis.stop()
+            return analysis.wait()
+    return run
+
+
+# --------------------------------------------------
+# EnginePlayer
+# --------------------------------------------------
+class EnginePlayer:
+    """
+    One game's engine. With `pool`, searches run on the shared EnginePool
+    (which, like `book`, then belongs to the caller): moves at
+    PRIORITY_MOVE, pondering as a cancellable PRIORITY_PONDER job that
+    gives its engine up to any board waiting for a move.
+    """
+
+    def __init__(self, engine_path, budget=None, options=None, book=None, pool=None):
+        self.pool = pool
+        self.engine = None
+        if pool is None:
+            self.engine = chess.engine.SimpleEngine.popen_uci(engine_path)
+            if options:
+                self.engine.configure(options)
+        self.budget = budget or SearchBudget()
+        self.book = book or MoveBook()
+
+        self._ponder = None          # chess.engine.SimpleAnalysisResult
+        self._ponder_fen = None      # position the background search is on
+        self._ponder_started = 0.0
+
+        self.ponder_hits = 0
+        self.ponder_misses = 0
+        self.book_hits = 0
+
+    # --------------------------------------------------
+    # Search
+    # --------------------------------------------------
+    def play(self, board):
+        """
+        Best move for `board`, plus the reply the engine expects (or None).
+        """
+        started = time.monotonic()
+        budget_key = self.budget.key()
+
+        hit = self.book.lookup(board, budget_key)
+        if hit is not None:
+            self.stop_ponder()
+            self.book_hits += 1
+            return hit
+
+        hit = self._take_ponder(board)
+        if hit is None:
+            limit = self.budget.limit()
+            if self.pool is None:
+                result = self.engine.play(board, limit)
+            else:
+                result, full = self._pool_play(board, limit, started)
+                if not full:
+                    # Weaker than the budget asks for; keep it out of the cache
+                    budget_key = None
+            hit = result.move, result.ponder
+
+        self.budget.charge(time.monotonic() - started)
+        self.book.store(board, budget_key, *hit)
+        return hit
+
+    def _pool_play(self, board, limit, started):
+        """
+        engine.play() on the pool, queued for at most MOVE_QUEUE_WAIT ×
+        move_time(), then a QUICK_DEPTH search. Returns (result, whether
+        it searched the full limit).
+        """
+        wait = MOVE_QUEUE_WAIT * self.budget.move_time()
+        deadline = started + wait if wait > 0 else None
+        try:
+            return self.pool.run(self, lambda engine, job: engine.play(board, limit),
+                                 priority=PRIORITY_MOVE, deadline=deadline), True
+        except TimeoutError:
+            log.warning("No free engine after %.1f s; playing a depth-%d search", wait, QUICK_DEPTH)
+        quick = chess.engine.Limit(depth=QUICK_DEPTH)
+        return self.pool.run(self, lambda engine, job: engine.play(board, quick),
+                             priority=PRIORITY_MOVE), False
+
+    # --------------------------------------------------
+    # Pondering
+    # --------------------------------------------------
+    def start_ponder(self, board, expected_reply):
+        """
+        Search the position after `expected_reply` until the next play().
+        `board` is the position after the computer's move.
+        """
+        self.stop_ponder()
+        if expected_reply is None or expected_reply not in board.legal_moves:
+            return
+
+        target = board.copy(stack=False)
+        target.push(expected_reply)
+        if target.is_game_over():
+            return
+
+        if self.pool is not None:
+            self._ponder = self.pool.submit(self, _pool_ponder(target),
+                                            priority=PRIORITY_PONDER, cancellable=True)
+        else:
+            self._ponder = self.engine.analysis(target)
+        self._ponder_fen = target.fen()
+        self._ponder_started = time.monotonic()
+
+    def ponder_guess(self):
+        """The background search's current best move, if it has one yet."""
+        if self._ponder is None:
+            return None
+        pv = self._ponder.info.get("pv")
+        return pv[0] if pv else None
+
+    def stop_ponder(self):
+        if self._ponder is None:
+            return
+        if self.pool is not None:
+            self._ponder.cancel()
+            self._ponder = None
+            self._ponder_fen = None
+            return
+        try:
+            self._ponder.stop()
+            self._ponder.wait()
+        except chess.engine.EngineError:
+            pass
+        self._ponder = None
+        self._ponder_fen = None
+
+    def _take_ponder(self, board):
+        if self._ponder is None:
+            return None
+        if board.fen() != self._ponder_fen:
+            self.ponder_misses += 1
+            self.stop_ponder()
+            return None
+        if self.pool is not None:
+            return self._take_pool_ponder(board)
+
+        # The player answered faster than the search limit: let the
+        # background search run out the rest of its budget
+        analysis = self._ponder
+        remaining = self.budget.move_time() - (time.monotonic() - self._ponder_started)
+        if remaining > 0:
+            time.sleep(remaining)
+        give_up = time.monotonic() + PONDER_TOPUP_MAX_S
+        while not self.budget.satisfied_by(analysis.info) and time.monotonic() < give_up:
+            time.sleep(PONDER_TICK_S)
+
+        self._ponder = None
+        self._ponder_fen = None
+        try:
+            analysis.stop()
+            best = analysis.wait()
+        except chess.engine.EngineError:
+            return None
+        if best.move is None or best.move not in board.legal_moves:
+            return None
+
+        self.ponder_hits += 1
+        return best.move, best.ponder
+
+    def _take_pool_ponder(self, board):
+        job = self._ponder
+        self._ponder = None
+        self._ponder_fen = None
+        if job.started is None:
+            # Never got an engine; searching now is no slower
+            job.cancel()
+            return None
+
+        # stopped is set early if another board's move pre-empts the job
+        remaining = self.budget.move_time() - (time.monotonic() - job.started)
+        if remaining > 0:
+            job.stopped.wait(remaining)
+        give_up = time.monotonic() + PONDER_TOPUP_MAX_S
+        while (not job.stopped.is_set() and not self.budget.satisfied_by(job.info)
+               and time.monotonic() < give_up):
+            time.sleep(PONDER_TICK_S)
+
+        job.cancel()
+        try:
+            best = job.result()
+        except (chess.engine.EngineError, CancelledError):
+            return None
+        if job.preempted or best.move is None or best.move not in board.legal_moves:
+            return None
+
+        self.ponder_hits += 1
+        return best.move, best.ponder
+
+    def quit(self):
+        self.stop_ponder()
+        if self.pool is None:
+            self.book.close()
+            self.engine.quit()
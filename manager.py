@@ -6,9 +6,11 @@ Raspberry Pi side of the Automatic Chess Board.
 This version:
   - Nano0 (left half) live reading
   - Nano1 (right half) still dummy None
-  - Detects physical move by polling every 1.5 sec
-  - When a DIFFERENT board appears → wait 2 seconds → confirm stability
-  - NEW stable board is printed using symbols and compared to cached legal-move FENs
+  - Detects physical move from blocks the Nanos push on change (stream mode),
+    falling back to back-to-back polling on firmware without CMD_STREAM
+  - When a DIFFERENT board appears → it must hold still for DEBOUNCE_MS
+  - NEW stable board is logged using symbols (log level debug) and compared to
+    cached legal-move FENs
 """
 
 """
@@ -16,20 +18,42 @@ HOW TO RUN:
 If doesn't work normally, so this:
 Run the code on the Pi
 Wait for it to say Connteing to Usb001 or whatever
-it will pause for 5 seconds
-In those 5 seconds, you must double-tap reset on Nano while 
+it will wait up to BOOT_TIMEOUT_S (10 s) for the Nano to answer
+In that time, you must double-tap reset on Nano while 
 simulataneously unplugging and then replugging the 5V out to mux's
 
 """
 
 import chess
 import chess.engine
+import collections
+import logging
+import operator
 import time
+import threading
 import yaml
 import serial
 import serial.tools.list_ports
-
-from motion import execute_uci_move
+from concurrent.futures import Future, ThreadPoolExecutor, wait
+from dataclasses import dataclass
+
+from engine import EnginePlayer, MoveBook, SearchBudget, engine_options
+from motion import (HOME_POS, Graveyard, build_route_table, execute_plan,
+                    plan_end, plan_move, plan_time, same_pos, send_park, square_pos)
+import console
+from console import deferred
+from recorder import RECORDER
+from timing import TRACER
+from protocol import (CAP_BATCH, CAP_BINARY, CAP_CHANNELS, CAP_FRAMED, CAP_NAMES, CAP_STREAM,
+                      FRAME_BLOCK, FRAME_CAPS, FRAME_CHANNELS, FRAME_MOTION_DONE, MOTION_OK,
+                      FrameParser, decode_block_payload, decode_channels_payload)
+
+# Optional native decoder (native/boardcodec.cpp); configured below once
+# the square lookup tables and Zobrist keys exist
+try:
+    import boardcodec
+except ImportError:
+    boardcodec = None
 
 # --------------------------------------------------
 # GLOBAL CONSTANTS
@@ -41,19 +65,108 @@ try:
     with open("config.yaml", "r") as f:
         config = yaml.safe_load(f)
         engine_path = config["path"]
+        engine_config = config.get("engine") or {}
 except Exception:
     raise Exception("Must initialize config.yaml with { path: stockfish_executable_path }")
 
+console.setup(config.get("log"))
+log = console.logger("manager")
+TRACER.configure(config.get("trace"))
+RECORDER.configure(config.get("record"))
+
 
 # --------------------------------------------------
 # Serial protocol constants (Nano firmware)
 # --------------------------------------------------
-CMD_GET_BLOCK = 0x01
+CMD_GET_BLOCK = 0x01   # legacy: reply is 32 raw bytes, no framing
 CMD_PING      = 0x02
+CMD_STREAM    = 0x03   # <0x03><1|0>: start/stop pushing FRAME_BLOCK on change
+CMD_GET_FRAME = 0x04   # <0x04><seq>: reply is one FRAME_BLOCK echoing seq
+CMD_GET_CHANNELS = 0x05  # <0x05><seq><mask: 4 bytes LE>: scan only those
+                         # readers; reply is one FRAME_CHANNELS echoing seq
+CMD_HELLO     = 0x06   # single byte: reply is one FRAME_CAPS; legacy firmware
+                       # stays silent (see protocol.py)
+
+# CMD_HELLO is asked HELLO_ATTEMPTS times, HELLO_TIMEOUT_S each, before a
+# Nano is taken as legacy
+HELLO_ATTEMPTS  = 3
+HELLO_TIMEOUT_S = 0.2
 
 NUM_READERS_PER_NANO = 32
 BLOCK_BYTES          = NUM_READERS_PER_NANO
 
+# A corrupt, stale or missing frame re-requests only that Nano's half;
+# the port timeout is split across the attempts, and while waiting for a
+# frame each read returns after FRAME_READ_S so a torn frame cannot hold
+# the port past its attempt's share
+FRAME_RETRIES = 2
+FRAME_READ_S  = 0.01
+
+# In stream mode the Nano pushes a FRAME_BLOCK (see protocol.py) once on
+# start and again whenever any reader's value changes.
+
+# Move detection: a new board must hold still this long before it is accepted
+STREAM_MODE    = True
+DEBOUNCE_MS    = 150
+STREAM_TICK_S  = 0.005   # idle wait between draining the stream buffers
+
+# Move detection filters every square on its own: a square's value only
+# changes once the new value fills VOTE_SWITCH of its last VOTE_SAMPLES
+# reads, so a reader flickering for a read or two never looks like a move
+VOTE_SAMPLES = 5
+VOTE_SWITCH  = 4
+# Streamed blocks arrive only on change, so there is nothing to vote over:
+# a pushed value must hold PUSH_HOLD_MS (a few full scans) instead, and
+# the debounce is timed from when it first appeared
+PUSH_HOLD_MS = 80
+
+# Initial board: sampled continuously and accepted once every square has
+# agreed with its majority value in at least STABLE_CONFIDENCE of the
+# samples over the last STABLE_WINDOW_MS (and at least STABLE_MIN_SAMPLES)
+STABLE_WINDOW_MS   = 300
+STABLE_MIN_SAMPLES = 3
+STABLE_CONFIDENCE  = 0.8
+STABLE_REPORT_S    = 2.0     # how often the squares holding it up are printed
+
+# Both halves are requested together and must arrive within one deadline;
+# halves read further apart than MAX_SKEW_MS are not used for stability
+SNAPSHOT_DEADLINE_S = 1.0
+MAX_SKEW_MS         = 50
+
+# Connection health: every block reply proves the Nano is alive, so pings
+# are only sent by the heartbeat when a port has been idle for HEARTBEAT_S.
+# A streaming port is asked for one framed block instead, whose reply
+# arrives among the pushes
+HEARTBEAT_S  = 2.0
+MAX_FAILURES = 3     # consecutive failed replies before a Nano is reported down
+PORT_DOWN_S  = 30.0  # a Nano down this long while the board is watched stops the game
+
+# Opening a port resets the Nano; instead of sleeping through the
+# bootloader, CMD_PING is polled with a short timeout and doubling backoff
+BOOT_TIMEOUT_S      = 10.0
+BOOT_PING_TIMEOUT_S = 0.05
+BOOT_BACKOFF_S      = 0.05    # first gap between pings
+BOOT_BACKOFF_MAX_S  = 0.5
+
+# Longest a single move may take on the gantry before its MOTION_BATCH
+# acknowledgement is given up on
+MOTION_DONE_TIMEOUT_S = 30.0
+
+# After the motion acknowledgement the moved squares are read back up to
+# VERIFY_RETRIES times; if the gantry failed, the player gets HAND_FIX_S to
+# finish the move by hand before the game is stopped
+VERIFY_RETRIES    = 5
+VERIFY_INTERVAL_S = 0.2
+HAND_FIX_S        = 120.0
+
+# Without MOTION_BATCH there is no acknowledgement, so verification also
+# waits out the plan's expected time (motion.plan_time) times this margin
+MOTION_TIME_MARGIN = 1.5
+
+# During the player's turn, park the empty head under the piece the
+# pondering search expects to move next, so the next plan starts there
+PARK_HEAD = True
+
 # Only Nano0 is active for now
 # NANO0_SERIAL = "A5069RR4"     # left half of the board
 NANO0_SERIAL = "A900DMBL"
@@ -68,80 +181,611 @@ NANO1_MAP = [4, 5, 2, 3, 1, 0, 6, 7]
 NANO1_MAP2 = [2, 3, 4, 5, 1, 0, 6, 7]
 
 # --------------------------------------------------
-# PRINTING HELPERS (now print SYMBOLS)
+# Flat board layout
+# --------------------------------------------------
+# Boards are 64-byte `bytes` of piece IDs indexed like chess.SQUARES
+# (a1 = 0, h1 = 7, h8 = 63); EMPTY marks a square with no piece.
+# Raw positions are Nano0's 32 bytes followed by Nano1's 32 bytes.
+NUM_SQUARES = 64
+EMPTY = 0
+EMPTY_BOARD = bytes(NUM_SQUARES)
+
+
+def _build_square_luts():
+    """
+    Compile the per-mux channel maps once into RAW_TO_SQUARE (raw position
+    → board square) and its inverse SQUARE_TO_RAW.
+    """
+    raw_to_square = [0] * 64
+    for nano in range(2):
+        for mux in range(4):
+            if nano == 0:
+                map_arr = NANO0_MAP
+            else:
+                map_arr = NANO1_MAP if mux == 0 else NANO1_MAP2
+            base = mux * 8
+            for i in range(8):
+                idx = base + map_arr.index(i)        # position within the half
+                rank, file = idx // 4, idx % 4 + 4 * nano
+                raw_to_square[nano * NUM_READERS_PER_NANO + base + i] = rank * 8 + file
+
+    square_to_raw = [0] * 64
+    for raw_pos, sq in enumerate(raw_to_square):
+        square_to_raw[sq] = raw_pos
+    return raw_to_square, square_to_raw
+
+RAW_TO_SQUARE, SQUARE_TO_RAW = _build_square_luts()
+_gather_squares = operator.itemgetter(*SQUARE_TO_RAW)
+
+
+# --------------------------------------------------
+# Zobrist placement hash
+# --------------------------------------------------
+# Keys come from a fixed splitmix64 stream so the hash is identical across
+# runs and between the Python and native decoders. Kind 0 (EMPTY) is all
+# zeros; piece IDs outside ID_TO_SYMBOL share the last kind.
+ZOBRIST_SEED  = 0x1D2C3B4A59687796
+ZOBRIST_KINDS = 14
+
+
+def _build_zobrist():
+    keys = [0] * (ZOBRIST_KINDS * 64)
+    state = ZOBRIST_SEED
+    for i in range(64, len(keys)):
+        state = (state + 0x9E3779B97F4A7C15) & 0xFFFFFFFFFFFFFFFF
+        z = state
+        z = ((z ^ (z >> 30)) * 0xBF58476D1CE4E5B9) & 0xFFFFFFFFFFFFFFFF
+        z = ((z ^ (z >> 27)) * 0x94D049BB133111EB) & 0xFFFFFFFFFFFFFFFF
+        keys[i] = z ^ (z >> 31)
+    return keys
+
+ZOBRIST = _build_zobrist()
+
+
+def zobrist_key(pid, sq):
+    return ZOBRIST[(pid if pid <= 12 else ZOBRIST_KINDS - 1) * 64 + sq]
+
+
+def _placement_hash_py(board):
+    """64-bit Zobrist hash of a flat board's piece placement."""
+    h = 0
+    for sq, pid in enumerate(board):
+        if pid != EMPTY:
+            h ^= zobrist_key(pid, sq)
+    return h
+
+
+if boardcodec is not None:
+    boardcodec.configure(bytes(SQUARE_TO_RAW),
+                         b"".join(k.to_bytes(8, "little") for k in ZOBRIST))
+    placement_hash = boardcodec.placement_hash
+else:
+    placement_hash = _placement_hash_py
+
+
+def decode_board(left_raw, right_raw):
+    """
+    Two 32-byte blocks → (flat 64-square board, placement hash), or None.
+    The pure-Python path is a single gather; boardcodec does the same
+    without copying the blocks.
+    """
+    if left_raw is None or right_raw is None:
+        return None
+    if len(left_raw) != NUM_READERS_PER_NANO or len(right_raw) != NUM_READERS_PER_NANO:
+        return None
+    if boardcodec is not None:
+        return boardcodec.decode(left_raw, right_raw)
+    board = bytes(_gather_squares(left_raw + right_raw))
+    return board, placement_hash(board)
+
+
+def decode_halves(left_raw, right_raw):
+    """
+    decode_board() without the hash, for samples that are only filtered;
+    the move lookup hashes the board that settles. boardcodec hashes in
+    the same pass, so it is used as is.
+    """
+    if boardcodec is not None:
+        decoded = decode_board(left_raw, right_raw)
+        return None if decoded is None else decoded[0]
+    if left_raw is None or right_raw is None:
+        return None
+    if len(left_raw) != NUM_READERS_PER_NANO or len(right_raw) != NUM_READERS_PER_NANO:
+        return None
+    return bytes(_gather_squares(left_raw + right_raw))
+
+# --------------------------------------------------
+# PRINTING HELPERS (SYMBOLS)
 # --------------------------------------------------
 ID_TO_SYMBOL = {
     1: "P", 2: "R", 3: "N", 4: "B", 5: "Q", 6: "K",
     7: "p", 8: "r", 9: "n",10: "b",11: "q",12: "k"
 }
 
+SYMBOL_TO_ID = {sym: pid for pid, sym in ID_TO_SYMBOL.items()}
+
 def pretty_symbol(cell):
-    if cell is None:
+    if cell == EMPTY:
         return "."
     return ID_TO_SYMBOL.get(cell, "?")
 
 
-def print_pretty_board(board):
-    print("\nBoard state (symbols):\n")
-    for r in range(8):
-        rank = 8 - r
-        row = board[r]
-        line = f"{rank} | "
-        for cell in row:
-            line += pretty_symbol(cell) + "  "
-        print(line)
-    print("\n    a  b  c  d  e  f  g  h\n")
+def pretty_board(board):
+    """8×8 diagram of a flat board; log it as deferred(pretty_board, board)."""
+    lines = ["Board state (symbols):", ""]
+    for rank in range(8, 0, -1):
+        row = board[(rank - 1) * 8:rank * 8]
+        lines.append(f"{rank} | " + "".join(pretty_symbol(cell) + "  " for cell in row))
+    lines += ["", "    a  b  c  d  e  f  g  h"]
+    return "\n".join(lines)
+
+
+# --------------------------------------------------
+# chess.Board ↔ flat board helpers
+# --------------------------------------------------
+def board_placement(board):
+    """Piece placement of a chess.Board as a flat board (bytearray)."""
+    flat = bytearray(64)
+    for sq, piece in board.piece_map().items():
+        flat[sq] = SYMBOL_TO_ID[piece.symbol()]
+    return flat
+
+
+def move_changes(board, mv):
+    """
+    Squares a legal move changes, as {square: new piece ID}, including the
+    rook for castling and the captured pawn for en passant.
+    """
+    piece = board.piece_at(mv.from_square)
+    if mv.promotion:
+        piece = chess.Piece(mv.promotion, piece.color)
+    pid = SYMBOL_TO_ID[piece.symbol()]
+
+    if board.is_castling(mv):
+        rank = chess.square_rank(mv.from_square)
+        kingside = board.is_kingside_castling(mv)
+        rook_from = chess.square(7 if kingside else 0, rank)
+        rook_to = chess.square(5 if kingside else 3, rank)
+        king_to = chess.square(6 if kingside else 2, rank)
+        rook_id = SYMBOL_TO_ID["R" if piece.color == chess.WHITE else "r"]
+        changes = {mv.from_square: EMPTY, rook_from: EMPTY}
+        changes[king_to] = pid
+        changes[rook_to] = rook_id
+        return changes
+
+    changes = {mv.from_square: EMPTY, mv.to_square: pid}
+    if board.is_en_passant(mv):
+        victim = chess.square(chess.square_file(mv.to_square), chess.square_rank(mv.from_square))
+        changes[victim] = EMPTY
+    return changes
 
 
 # --------------------------------------------------
 # SerialNano — connects to Nano by USB serial_number
 # --------------------------------------------------
+class HeartbeatLoop:
+    """
+    One thread checks every registered Nano, however many boards the
+    process drives. Only idle ports are checked: a quiet port is pinged,
+    a quiet streaming port gets a keepalive() (a raw ping reply would
+    land in the push stream), and a port busy with a read or motion
+    batch is skipped rather than waited on.
+    """
+
+    def __init__(self):
+        self.nanos = []
+        self._lock = threading.Lock()
+        self._thread = None
+
+    def add(self, nano):
+        with self._lock:
+            if nano not in self.nanos:
+                self.nanos.append(nano)
+            if self._thread is None:
+                self._thread = threading.Thread(target=self._loop, name="heartbeat", daemon=True)
+                self._thread.start()
+
+    def _loop(self):
+        while True:
+            time.sleep(HEARTBEAT_S / 2)
+            with self._lock:
+                self.nanos = [n for n in self.nanos if not n._closing.is_set()]
+                nanos = list(self.nanos)
+            for nano in nanos:
+                if time.monotonic() - nano.last_seen < HEARTBEAT_S:
+                    continue
+                if not nano.lock.acquire(blocking=False):
+                    continue
+                try:
+                    # start_stream() holds the lock across its handshake,
+                    # so this is settled once the lock is ours
+                    if nano.streaming:
+                        nano.keepalive()
+                    else:
+                        nano.ping()
+                finally:
+                    nano.lock.release()
+
+HEARTBEAT = HeartbeatLoop()
+
+
+def discover_ports():
+    """USB serial number -> device path for every attached serial port, in one scan."""
+    return {p.serial_number: p.device for p in serial.tools.list_ports.comports()
+            if p.serial_number}
+
+
 class SerialNano:
-    def __init__(self, serial_number, baud=115200, timeout=1.0, label="Nano"):
+    def __init__(self, serial_number, baud=115200, timeout=1.0, label="Nano", port_name=None,
+                 ser=None):
         self.serial_number = serial_number
+        self.port_name = port_name   # from discover_ports(); scanned here if None
         self.baud = baud
         self.timeout = timeout
         self.label = label
-        self.ser = None
-        self._open_port()
+        self.ser = ser               # an already open SerialLike (sim.py), else opened here
+        # One request/response in flight per port; reentrant so a motion
+        # batch can hold it from upload to acknowledgement
+        self.lock = threading.RLock()
+        self.streaming = False
+        self.latest_block = None
+
+        # CAP_* bits from the CMD_HELLO reply (0 = legacy firmware); no
+        # multi-byte command is sent unless its bit is set
+        self.caps = 0
+        self.framed = False
+        self.channel_reads = False
+        self.stream_support = False
+        self._streamed = False       # a CMD_STREAM has been answered at least once
+        self._seq = 0
+        self._parser = FrameParser()
+        self._last_good = bytearray(NUM_READERS_PER_NANO)
+        # recorder.py source id, set by RECORDER.register(); 0 = not recorded
+        self.record_source = 0
+
+        # Health, updated by every reply (blocks, stream pushes, pings)
+        self.last_seen = 0.0
+        self.failures = 0
+        self._keepalive_at = 0.0
+        self._closing = threading.Event()
+
+        if self.ser is None:
+            self._open_port()
+        else:
+            self._wait_ready()
+        self._negotiate()
 
     def _open_port(self):
-        port_name = None
-        for p in serial.tools.list_ports.comports():
-            if p.serial_number == self.serial_number:
-                port_name = p.device
-                break
-
+        port_name = self.port_name or discover_ports().get(self.serial_number)
         if port_name is None:
             raise RuntimeError(f"{self.label}: No USB device with serial {self.serial_number}")
 
-        print(f"[{self.label}] Connecting on {port_name}")
+        log.info("[%s] Connecting on %s", self.label, port_name)
         self.ser = serial.Serial(port_name, baudrate=self.baud, timeout=self.timeout)
-        time.sleep(5.0)   # Nano bootloader reset delay
+        self._wait_ready()
 
-    def ping(self):
+    def _wait_ready(self):
+        started = time.monotonic()
+        delay = BOOT_BACKOFF_S
+        self.ser.timeout = BOOT_PING_TIMEOUT_S
         try:
+            while time.monotonic() - started < BOOT_TIMEOUT_S:
+                if self._ping_once():
+                    self._mark(True)
+                    log.info("[%s] ready after %.2f s", self.label, time.monotonic() - started)
+                    return True
+                time.sleep(delay)
+                delay = min(2 * delay, BOOT_BACKOFF_MAX_S)
+        finally:
+            self.ser.timeout = self.timeout
             self.ser.reset_input_buffer()
-            self.ser.write(bytes([CMD_PING]))
+        log.warning("[%s] no reply to CMD_PING after %.0f s; continuing", self.label, BOOT_TIMEOUT_S)
+        return False
+
+    def _negotiate(self):
+        """Ask the firmware for its CAP_* bits with the single-byte CMD_HELLO."""
+        with self.lock:
+            for _ in range(HELLO_ATTEMPTS):
+                try:
+                    self.ser.reset_input_buffer()
+                    self._parser.reset()
+                    self.ser.write(bytes([CMD_HELLO]))
+                    self.ser.flush()
+                    frame = self._await_frame(FRAME_CAPS, 0, time.monotonic() + HELLO_TIMEOUT_S)
+                except:
+                    frame = None
+                if frame is not None and frame.payload:
+                    self.caps = frame.payload[0]
+                    break
+            else:
+                log.warning("[%s] no CMD_HELLO reply: legacy firmware, raw CMD_GET_BLOCK only",
+                            self.label)
+        self.framed = bool(self.caps & CAP_FRAMED)
+        # Both need framed replies as well
+        self.channel_reads = self.framed and bool(self.caps & CAP_CHANNELS)
+        self.stream_support = self.framed and bool(self.caps & CAP_STREAM)
+        log.info("[%s] firmware: %s", self.label,
+                 ", ".join(name for bit, name in CAP_NAMES if self.caps & bit) or "legacy")
+
+    # --------------------------------------------------
+    # Connection health
+    # --------------------------------------------------
+    def _mark(self, ok):
+        if ok:
+            self.last_seen = time.monotonic()
+            self.failures = 0
+        else:
+            self.failures += 1
+            TRACER.count(f"{self.label}.failures")
+            if self.failures == MAX_FAILURES:
+                log.warning("[%s] not responding", self.label)
+        return ok
+
+    @property
+    def alive(self):
+        return self.failures < MAX_FAILURES
+
+    def start_heartbeat(self):
+        HEARTBEAT.add(self)
+
+    def ping(self):
+        return self._mark(self._ping_once())
+
+    def keepalive(self):
+        """
+        While streaming: request one framed block without touching the
+        input buffer; poll_stream() takes the reply like a push. A
+        request still unanswered from last time counts as a failure.
+        """
+        with self.lock:
+            self.poll_stream()
+            if self._keepalive_at > self.last_seen:
+                self._mark(False)
+            try:
+                self.ser.write(bytes([CMD_GET_FRAME, self.next_seq()]))
+                self.ser.flush()
+            except:
+                self._mark(False)
+            self._keepalive_at = time.monotonic()
+
+    def _ping_once(self):
+        with self.lock:
+            try:
+                self.ser.reset_input_buffer()
+                self.ser.write(bytes([CMD_PING]))
+                self.ser.flush()
+                return bool(self.ser.read(1))
+            except:
+                return False
+
+    def get_block(self, expected_len=BLOCK_BYTES):
+        with self.lock:
+            if self.framed:
+                return self._get_framed_block(expected_len)
+            return self._get_raw_block(expected_len)
+
+    def get_channels(self, channels):
+        """
+        Scan only `channels` (reader positions 0..31) and return
+        {channel: piece ID}. Without CMD_GET_CHANNELS in the firmware, or
+        if its reply is lost, the values come from a full get_block().
+        """
+        with self.lock:
+            if self.channel_reads:
+                values = self._get_framed_channels(channels)
+                if values is not None:
+                    return values
+            block = self.get_block()
+            return None if block is None else {ch: block[ch] for ch in channels}
+
+    def _get_framed_channels(self, channels):
+        mask = 0
+        for ch in channels:
+            mask |= 1 << ch
+        seq = self.next_seq()
+        t0 = time.perf_counter()
+        try:
+            self.ser.write(bytes([CMD_GET_CHANNELS, seq]) + mask.to_bytes(4, "little"))
             self.ser.flush()
-            resp = self.ser.read(1)
-            return bool(resp)
+            frame = self._await_frame(FRAME_CHANNELS, seq, time.monotonic() + self.timeout)
         except:
-            return False
+            frame = None
+        decoded = None if frame is None else decode_channels_payload(frame.payload)
+        if decoded is None or decoded[0] != mask:
+            return None
 
-    def get_block(self, expected_len=BLOCK_BYTES):
+        _, status, values = decoded
+        TRACER.rtt(f"{self.label} channels", time.perf_counter() - t0)
+        self._mark(True)
+        for ch, v in values.items():
+            if (status >> ch) & 1:
+                self._last_good[ch] = v
+        RECORDER.channels(self.record_source, mask,
+                          (v for ch, v in enumerate(self._last_good) if (mask >> ch) & 1))
+        return {ch: self._last_good[ch] for ch in channels}
+
+    def _get_raw_block(self, expected_len):
         try:
             self.ser.reset_input_buffer()
+            t0 = time.perf_counter()
             self.ser.write(bytes([CMD_GET_BLOCK]))
             self.ser.flush()
             data = self.ser.read(expected_len)
             if len(data) != expected_len:
+                self._mark(False)
                 return None
-            return list(data)
+            TRACER.rtt(self.label, time.perf_counter() - t0)
+            self._mark(True)
+            RECORDER.block(self.record_source, data)
+            return bytes(data)
         except:
+            self._mark(False)
             return None
 
+    def next_seq(self):
+        self._seq = (self._seq + 1) & 0xFF
+        return self._seq
+
+    def _get_framed_block(self, expected_len):
+        deadline = time.monotonic() + self.timeout
+        for attempt in range(1 + FRAME_RETRIES):
+            now = time.monotonic()
+            attempt_deadline = now + (deadline - now) / (1 + FRAME_RETRIES - attempt)
+            seq = self.next_seq()
+            t0 = time.perf_counter()
+            try:
+                self.ser.write(bytes([CMD_GET_FRAME, seq]))
+                self.ser.flush()
+                frame = self._await_frame(FRAME_BLOCK, seq, attempt_deadline)
+            except:
+                frame = None
+
+            if frame is not None:
+                decoded = decode_block_payload(frame.payload)
+                if decoded is not None and len(decoded[1]) == expected_len:
+                    TRACER.rtt(self.label, time.perf_counter() - t0)
+                    self._mark(True)
+                    return self._apply_status(*decoded)
+
+            if time.monotonic() >= deadline:
+                break
+            # Whatever is left of a torn frame must not fail the next attempt
+            self._parser.reset()
+
+        self._mark(False)
+        return None
+
+    def _await_frame(self, ftype, seq, deadline):
+        """
+        Read until the frame answering `seq` arrives. Frames left over from
+        earlier requests are dropped by their sequence number; a CRC failure
+        returns None at once so the caller can re-request.
+        """
+        crc_errors = self._parser.crc_errors
+        frames = self._parser.feed(b"")
+        self.ser.timeout = FRAME_READ_S
+        try:
+            while True:
+                for f in frames:
+                    if f.type == ftype and f.seq == seq:
+                        return f
+                if self._parser.crc_errors != crc_errors or time.monotonic() >= deadline:
+                    return None
+                frames = self._parser.feed(self.ser.read(self.ser.in_waiting or 1))
+        finally:
+            self.ser.timeout = self.timeout
+
+    def wait_motion_done(self, seq, timeout=MOTION_DONE_TIMEOUT_S):
+        """
+        Wait for the FRAME_MOTION_DONE answering MOTION_BATCH `seq`.
+        Returns (status, steps completed), or None on timeout.
+        """
+        deadline = time.monotonic() + timeout
+        with self.lock:
+            while time.monotonic() < deadline:
+                try:
+                    frame = self._await_frame(FRAME_MOTION_DONE, seq, deadline)
+                except:
+                    return None
+                if frame is not None and len(frame.payload) >= 2:
+                    self._mark(True)
+                    return frame.payload[0], frame.payload[1]
+        return None
+
+    def _apply_status(self, status, values):
+        """
+        Readers whose status bit is clear were not read this scan; keep
+        their last good value instead of reporting the square empty.
+        """
+        for i, v in enumerate(values):
+            if (status >> i) & 1:
+                self._last_good[i] = v
+        block = bytes(self._last_good)
+        RECORDER.block(self.record_source, block)
+        return block
+
+    # --------------------------------------------------
+    # Stream mode: Nano pushes a block whenever a reader changes
+    # --------------------------------------------------
+    def start_stream(self):
+        """
+        Ask the Nano to push blocks on change (only if it listed
+        CAP_STREAM). The firmware answers with the current block right
+        away. The port lock is held for the whole handshake, so a
+        heartbeat ping cannot swallow that first push.
+        """
+        with self.lock:
+            if not self.stream_support:
+                return False
+            try:
+                self.ser.reset_input_buffer()
+                self.ser.write(bytes([CMD_STREAM, 1]))
+                self.ser.flush()
+            except:
+                return False
+
+            self._parser.reset()
+            self.latest_block = None
+            self.streaming = True
+
+            deadline = time.monotonic() + self.timeout
+            while self.latest_block is None and time.monotonic() < deadline:
+                if self.poll_stream() is None:
+                    time.sleep(STREAM_TICK_S)
+
+            if self.latest_block is None:
+                self.stop_stream()
+                if not self._streamed:
+                    # Listed but never worked: not tried again
+                    log.warning("[%s] no CMD_STREAM reply, polling from now on", self.label)
+                    self.stream_support = False
+                return False
+            self._streamed = True
+            return True
+
+    def stop_stream(self):
+        with self.lock:
+            self.streaming = False
+            if not self.stream_support:
+                return
+            try:
+                self.ser.write(bytes([CMD_STREAM, 0]))
+                self.ser.flush()
+                time.sleep(STREAM_TICK_S)
+                self.ser.reset_input_buffer()
+            except:
+                pass
+            self._parser.reset()
+
+    def poll_stream(self):
+        """
+        Drain whatever the Nano has pushed so far without blocking.
+        Returns the newest complete block, or None if nothing new arrived.
+        A port that cannot be read counts as a failed reply.
+        """
+        with self.lock:
+            try:
+                waiting = self.ser.in_waiting
+                frames = self._parser.feed(self.ser.read(waiting) if waiting else b"")
+            except:
+                self._mark(False)
+                return None
+
+            newest = None
+            for f in frames:
+                if f.type != FRAME_BLOCK:
+                    continue
+                decoded = decode_block_payload(f.payload)
+                if decoded is not None and len(decoded[1]) == BLOCK_BYTES:
+                    newest = self._apply_status(*decoded)
+
+            if newest is not None:
+                self.latest_block = newest
+                self._mark(True)
+            return newest
+
     def close(self):
+        self._closing.set()
         try:
             self.ser.close()
         except:
@@ -149,99 +793,543 @@ class SerialNano:
 
 
 # --------------------------------------------------
-# GameManager
+# Snapshot — one 8×8 board plus when each half was read
 # --------------------------------------------------
-class GameManager:
-    def __init__(self, engine_path):
-        self.board      = chess.Board()
-        self.engine     = chess.engine.SimpleEngine.popen_uci(engine_path)
-        self.current_turn = PLAYER
+@dataclass
+class Snapshot:
+    board: bytes     # flat 64-square board
+    t_left: float    # time.monotonic() when Nano0's block arrived
+    t_right: float   # time.monotonic() when Nano1's block arrived
 
-        # The last accepted 8×8 board
-        self.physical_board = [[None for _ in range(8)] for _ in range(8)]
+    @property
+    def skew_ms(self):
+        return abs(self.t_left - self.t_right) * 1000.0
 
-        # Single active Nano (left half)
-        self.nano0 = SerialNano(NANO0_SERIAL, label="Nano0")
-        self.nano1 = SerialNano(NANO1_SERIAL, label="Nano1")
 
-    # --------------------------------------------------
-    # Apply mapping & convert 32-byte block → 8×4 matrix
-    # --------------------------------------------------
-    def _remap_and_reshape_half(self, raw_block, Nano0=True):
-        if raw_block is None or len(raw_block) != NUM_READERS_PER_NANO:
+# --------------------------------------------------
+# MoveTracker — follows a move while it is being made
+# --------------------------------------------------
+IDLE, IN_TRANSIT, COMPLETE, UNKNOWN = "idle", "in-transit", "complete", "unknown"
+
+class MoveTracker:
+    """
+    Classifies each stable board against the last accepted one (`base`):
+
+      IDLE        nothing changed
+      IN_TRANSIT  every changed square belongs to some legal move and is
+                  either emptied or already holds its final piece — a lifted
+                  piece, a removed capture, the king moved before the rook
+      COMPLETE    the changed squares are exactly one move's change set
+      UNKNOWN     anything else
+
+    COMPLETE is one lookup of the board's placement hash in the legal-move
+    index (GameManager._build_move_index); IN_TRANSIT only checks the
+    moves that touch one of the changed squares.
+
+    While IN_TRANSIT, `watch` holds the squares of the moves still possible.
+    """
+
+    def __init__(self, base, index):
+        self.base = base
+        self.index = index          # placement hash -> [(chess.Move, {square: new piece ID})]
+        self.by_square = collections.defaultdict(list)
+        for entries in index.values():
+            for mv, ch in entries:
+                for sq in ch:
+                    self.by_square[sq].append((mv, ch))
+        self.state = IDLE
+        self.candidates = []
+        self.watch = None
+
+    def update(self, board):
+        base = self.base
+        changed = {sq: pid for sq, pid in enumerate(board) if pid != base[sq]}
+
+        self.candidates = []
+        self.watch = None
+        if not changed:
+            self.state = IDLE
+            return self.state, None
+
+        for mv, ch in self.index.get(placement_hash(board), ()):
+            if ch == changed:
+                self.state = COMPLETE
+                return self.state, mv
+
+        for mv, ch in self.by_square.get(next(iter(changed)), ()):
+            if all(sq in ch and (pid == EMPTY or pid == ch[sq]) for sq, pid in changed.items()):
+                self.candidates.append((mv, ch))
+
+        if not self.candidates:
+            self.state = UNKNOWN
+            return self.state, None
+
+        self.state = IN_TRANSIT
+        self.watch = sorted({sq for _, ch in self.candidates for sq in ch})
+        return self.state, None
+
+    def move_squares(self, board):
+        """
+        Squares of every legal move that `board` could be on the way to:
+        the move touches a changed square and each of its own squares
+        still holds its old piece, is empty or holds its new piece.
+        Changes on any other square cannot turn into a legal move.
+        """
+        base = self.base
+        squares = set()
+        for sq, pid in enumerate(board):
+            if pid == base[sq]:
+                continue
+            for _, ch in self.by_square.get(sq, ()):
+                if all(board[s] in (base[s], EMPTY, p) for s, p in ch.items()):
+                    squares.update(ch)
+        return sorted(squares)
+
+
+# --------------------------------------------------
+# SquareFilter — per-square majority vote with hysteresis
+# --------------------------------------------------
+class SquareFilter:
+    """
+    Ring buffer of the last `k` reads per square. A square's filtered
+    value moves to a new piece ID only once that ID holds `switch` of
+    the slots, and then stays until another ID does.
+
+    Streamed boards go through hold() instead: a square's new value must
+    be pushed and stay for `hold_ms`. `switched_at` is when the raw value
+    first showed for the squares the last call switched (None if none).
+    """
+
+    def __init__(self, board, k=VOTE_SAMPLES, switch=VOTE_SWITCH, hold_ms=PUSH_HOLD_MS):
+        self.switch = switch
+        self.hold_s = hold_ms / 1000.0
+        self.value = bytearray(board)
+        self.rings = [collections.deque([pid] * k, maxlen=k) for pid in board]
+        self.pending = {}           # square -> (raw piece ID, first seen)
+        self.switched_at = None
+
+    def add(self, board):
+        value = self.value
+        for sq, pid in enumerate(board):
+            ring = self.rings[sq]
+            ring.append(pid)
+            if pid != value[sq] and ring.count(pid) >= self.switch:
+                value[sq] = pid
+        return bytes(value)
+
+    def hold(self, t, board):
+        """The latest pushed `board` as of time `t`; call it every tick, not per push."""
+        value, pending = self.value, self.pending
+        self.switched_at = None
+        for sq, pid in enumerate(board):
+            if pid == value[sq]:
+                pending.pop(sq, None)
+                continue
+            seen = pending.get(sq)
+            if seen is None or seen[0] != pid:
+                pending[sq] = (pid, t)
+            elif t - seen[1] >= self.hold_s:
+                value[sq] = pid
+                del pending[sq]
+                self.switched_at = max(self.switched_at or seen[1], seen[1])
+        return bytes(value)
+
+
+# --------------------------------------------------
+# StabilityWindow — settles the initial board
+# --------------------------------------------------
+class StabilityWindow:
+    """
+    Rolling time window over a continuous stream of boards. Every square
+    keeps a count of each value seen in the window; its confidence is the
+    share of samples that agree with its most common value. The
+    majority board is stable once every square is confident, so one
+    reader flickering now and then does not restart the wait.
+    """
+
+    def __init__(self, window_ms=STABLE_WINDOW_MS, min_samples=STABLE_MIN_SAMPLES,
+                 confidence=STABLE_CONFIDENCE):
+        self.window_s = window_ms / 1000.0
+        self.min_samples = min_samples
+        self.threshold = confidence
+        self.samples = collections.deque()      # (t, board)
+        self.counts = [collections.Counter() for _ in range(NUM_SQUARES)]
+        self.started = None
+
+    def add(self, t, board):
+        if self.started is None:
+            self.started = t
+        self.samples.append((t, board))
+        for sq, pid in enumerate(board):
+            self.counts[sq][pid] += 1
+        while self.samples and self.samples[0][0] < t - self.window_s:
+            _, old = self.samples.popleft()
+            for sq, pid in enumerate(old):
+                c = self.counts[sq]
+                c[pid] -= 1
+                if not c[pid]:
+                    del c[pid]
+
+    def majority(self):
+        return bytes(c.most_common(1)[0][0] for c in self.counts)
+
+    def confidence(self):
+        n = len(self.samples)
+        return [c.most_common(1)[0][1] / n for c in self.counts] if n else [0.0] * NUM_SQUARES
+
+    def weak_squares(self):
+        return [(chess.square_name(sq), conf) for sq, conf in enumerate(self.confidence())
+                if conf < self.threshold]
+
+    def stable(self, now):
+        """The majority board if it has settled, else None."""
+        if len(self.samples) < self.min_samples or now - self.started < self.window_s:
+            return None
+        if self.weak_squares():
             return None
+        return self.majority()
+
+
+# --------------------------------------------------
+# GameManager
+# --------------------------------------------------
+def _close_quietly(future):
+    """Done-callback that releases whatever a failed startup did open."""
+    if future.exception() is not None:
+        return
+    obj = future.result()
+    try:
+        if isinstance(obj, SerialNano):
+            obj.close()
+        else:
+            obj.quit()
+    except:
+        pass
 
-        remapped = [0] * NUM_READERS_PER_NANO
-        for mux in range(4):
-            if Nano0:
-                map_arr = NANO0_MAP
-            else:
-                if mux == 0:
-                    map_arr = NANO1_MAP
-                else:
-                    map_arr = NANO1_MAP2
-            base = mux * 8
-            for i in range(8):
-                old_idx = base + i
-                new_idx = base + map_arr.index(i)
-                remapped[new_idx] = raw_block[old_idx]
 
-        half = [[None for _ in range(4)] for _ in range(8)]
-        for idx, val in enumerate(remapped):
-            row = idx // 4
-            col = idx % 4
-            half[row][col] = None if val == 0 else val
+class GameStopped(Exception):
+    """Raised out of the wait loops once GameManager.stop() was called."""
 
-        half.reverse()
-        return half
+
+class GameManager:
+    """
+    One physical board. On its own (python manager.py) it owns its engine
+    and reader threads; server.py runs several in one process and hands
+    each the shared EnginePool, MoveBook and I/O pool, which then belong
+    to the server.
+
+    sim.py passes `ports` (serial number -> open SerialLike) and a ready
+    `engine` instead of real devices and Stockfish.
+    """
+
+    def __init__(self, engine_path, engine_config=None,
+                 nano_serials=(NANO0_SERIAL, NANO1_SERIAL), label=None,
+                 pool=None, book=None, io_pool=None, ports=None, engine=None):
+        self.label      = label
+        self.board      = chess.Board()
+        self.expected_reply = None
+        self.current_turn = PLAYER
+
+        # The last accepted board (flat, see EMPTY_BOARD)
+        self.physical_board = EMPTY_BOARD
+        # The last board that held still (accepted or not); move detection
+        # waits for the board to move away from this one
+        self.last_stable_board = self.physical_board
+        self.streaming = False
+        # Set by stop(); every wait loop checks it (see _check_ports)
+        self.stopping = threading.Event()
+
+        # One worker per Nano so both halves are read at the same time
+        self._own_io_pool = io_pool is None
+        self._io_pool = io_pool or ThreadPoolExecutor(max_workers=2, thread_name_prefix="nano-io")
+
+        # Legal-move index for self.board, built in the background as soon
+        # as the position is known; dropped only when push_move() changes it
+        self._cache_pool = ThreadPoolExecutor(max_workers=1, thread_name_prefix="move-cache")
+        self._cache_future = None
+        self.move_index = None
+        self.tracker = None
+        # Per-square vote over recent reads; restarted from each accepted board
+        self.square_filter = None
+
+        # Startup runs in parallel: the engine spawns (on the still idle
+        # move-cache worker) while both ports open and the Nanos boot
+        if engine is None:
+            engine_future = self._cache_pool.submit(
+                EnginePlayer, engine_path,
+                budget=SearchBudget.from_config(engine_config),
+                options=engine_options(engine_config),
+                book=book or MoveBook.from_config(engine_config),
+                pool=pool)
+        else:
+            engine_future = Future()
+            engine_future.set_result(engine)
+        devices = discover_ports() if ports is None else {}
+        prefix = f"{label}/" if label else ""
+        nano_futures = [self._io_pool.submit(SerialNano, serial_number,
+                                             label=f"{prefix}Nano{i}",
+                                             port_name=devices.get(serial_number),
+                                             ser=None if ports is None else ports[serial_number])
+                        for i, serial_number in enumerate(nano_serials)]
+        try:
+            self.nano0, self.nano1 = (f.result() for f in nano_futures)
+            self.engine = engine_future.result()
+        except Exception:
+            for f in nano_futures + [engine_future]:
+                f.add_done_callback(_close_quietly)
+            raise
+        self.nano0.start_heartbeat()
+        self.nano1.start_heartbeat()
+        RECORDER.register(self.nano0, 0, board=label or "")
+        RECORDER.register(self.nano1, 1, board=label or "")
+
+        # Off-board slots the computer's captures go to
+        self.graveyard = Graveyard()
+
+        # Gantry head position in board coordinates, trusted only after a
+        # FRAME_MOTION_DONE with MOTION_OK; None whenever it is unknown.
+        # head_guess is where the head was last sent (HOME_POS after boot),
+        # used only to order the next plan and estimate its time, never to
+        # skip a move
+        self.head = None
+        self.head_guess = HOME_POS
+        # When an unacknowledged motion should be finished; None once acked
+        self.motion_eta = None
+        # Fill the route table while the first position is being read
+        threading.Thread(target=build_route_table, name="route-table", daemon=True).start()
+
+        # Motion protocol variant, from Nano0's CMD_HELLO reply
+        self.motion_caps = self.nano0.caps
+        log.info("[%s] motion: %s, %s", self.nano0.label,
+                 "batch" if self.motion_caps & CAP_BATCH else "per-step",
+                 "binary" if self.motion_caps & CAP_BINARY else "ASCII")
 
     # --------------------------------------------------
     # Read left half from Nano0
     # --------------------------------------------------
     def _read_half_from_nano0(self):
-        if not self.nano0.ping():
-            print("Nano0 ping failed")
-            return None
-        raw = self.nano0.get_block()
-        if raw is None:
-            return None
-        return self._remap_and_reshape_half(raw, Nano0=True)
+        return self.nano0.get_block()
     
     # --------------------------------------------------
     # Read right half from Nano1
     # --------------------------------------------------
     def _read_half_from_nano1(self):
-        if not self.nano1.ping():
-            print("Nano1 ping failed")
+        return self.nano1.get_block()
+
+    # --------------------------------------------------
+    # Read both halves concurrently → timestamped snapshot
+    # --------------------------------------------------
+    @staticmethod
+    def _timed(read_half):
+        half = read_half()
+        return half, time.monotonic()
+
+    @TRACER.traced("snapshot")
+    def read_snapshot(self, deadline_s=SNAPSHOT_DEADLINE_S):
+        f_left = self._io_pool.submit(self._timed, self._read_half_from_nano0)
+        f_right = self._io_pool.submit(self._timed, self._read_half_from_nano1)
+
+        done, _ = wait([f_left, f_right], timeout=deadline_s)
+        if len(done) != 2:
+            log.warning("Snapshot deadline missed")
             return None
-        raw = self.nano1.get_block()
-        if raw is None:
+
+        left, t_left = f_left.result()
+        right, t_right = f_right.result()
+        board = decode_halves(left, right)
+        if board is None:
             return None
-        return self._remap_and_reshape_half(raw, Nano0=False)
+
+        return Snapshot(board, t_left, t_right)
+
+    @TRACER.traced("read_squares")
+    def read_squares(self, squares):
+        """
+        Read only `squares`: SQUARE_TO_RAW gives each its Nano and reader
+        channel, and only those channels are scanned, on both Nanos at
+        once. Returns {square: piece ID}, or None if a Nano did not answer.
+        """
+        channels = ([], [])
+        for sq in squares:
+            raw = SQUARE_TO_RAW[sq]
+            channels[raw >= BLOCK_BYTES].append(raw % BLOCK_BYTES)
+
+        futures = [self._io_pool.submit(nano.get_channels, chans) if chans else None
+                   for nano, chans in zip((self.nano0, self.nano1), channels)]
+        done, _ = wait([f for f in futures if f is not None], timeout=SNAPSHOT_DEADLINE_S)
+        if any(f is not None and f not in done for f in futures):
+            log.warning("Snapshot deadline missed")
+            return None
+        halves = [None if f is None else f.result() for f in futures]
+        if any(f is not None and h is None for f, h in zip(futures, halves)):
+            return None
+
+        values = {}
+        for sq in squares:
+            raw = SQUARE_TO_RAW[sq]
+            values[sq] = halves[raw >= BLOCK_BYTES][raw % BLOCK_BYTES]
+        return values
+
+    def assemble_full_board(self):
+        snap = self.read_snapshot()
+        return None if snap is None else snap.board
 
     # --------------------------------------------------
-    # Convert half-boards → full 8×8 (right half dummy)
+    # Stream mode on both Nanos (falls back to polling)
     # --------------------------------------------------
-    def assemble_full_board(self):
-        left = self._read_half_from_nano0()
-        if left is None:
-            return None
-        
-        right = self._read_half_from_nano1()
-        if right is None:
+    def start_streaming(self):
+        if not STREAM_MODE or self.streaming:
+            return self.streaming
+        if not (self.nano0.stream_support and self.nano1.stream_support):
+            return False
+        if self.nano0.start_stream() and self.nano1.start_stream():
+            self.streaming = True
+        else:
+            log.warning("Stream mode unavailable, polling instead")
+            self.nano0.stop_stream()
+            self.nano1.stop_stream()
+        return self.streaming
+
+    def stop_streaming(self):
+        if not self.streaming:
+            return
+        self.nano0.stop_stream()
+        self.nano1.stop_stream()
+        self.streaming = False
+
+    def _sample_board(self, watch=None):
+        """
+        Current snapshot: the newest pushed halves in stream mode, or one
+        concurrent request/response read of both Nanos otherwise. When
+        polling with `watch`, only those squares are scanned and the rest
+        keep their current filtered values.
+        """
+        if not self.streaming:
+            if watch:
+                return self._sample_squares(watch)
+            return self.read_snapshot()
+
+        self.nano0.poll_stream()
+        self.nano1.poll_stream()
+        board = decode_halves(self.nano0.latest_block, self.nano1.latest_block)
+        if board is None:
             return None
 
-        # right = [[None for _ in range(4)] for _ in range(8)]
-        
-        full = [[None for _ in range(8)] for _ in range(8)]
+        # A pushed block stays valid until the next push, so both halves
+        # describe the board as of now
+        now = time.monotonic()
+        return Snapshot(board, now, now)
 
-        for r in range(8):
-            for c in range(4):
-                full[r][c] = left[r][c]
-            for c in range(4):
-                full[r][c+4] = right[r][c]
+    def _sample_squares(self, squares):
+        values = self.read_squares(squares)
+        if values is None:
+            return None
+        base = self.square_filter.value if self.square_filter is not None else self.last_stable_board
+        board = bytearray(base)
+        for sq, pid in values.items():
+            board[sq] = pid
+        board = bytes(board)
+        now = time.monotonic()
+        return Snapshot(board, now, now)
+
+    def _check_ports(self, down_since, now):
+        """
+        For the wait loops: None while both Nanos answer, else when one
+        was first seen down (pass it back in). Raises once that was
+        PORT_DOWN_S ago, so an unplugged Nano stops the game, and raises
+        GameStopped once stop() was called.
+        """
+        if self.stopping.is_set():
+            raise GameStopped()
+        down = [nano.label for nano in (self.nano0, self.nano1) if not nano.alive]
+        if not down:
+            return None
+        if down_since is None:
+            return now
+        if now - down_since >= PORT_DOWN_S:
+            raise Exception(f"{', '.join(down)} not responding for {PORT_DOWN_S:.0f} s")
+        return down_since
+
+    @TRACER.traced("initial_board")
+    def wait_for_initial_board(self):
+        """
+        Sample the board continuously until a StabilityWindow settles.
+        Squares still holding it up are printed every STABLE_REPORT_S.
+        """
+        window = StabilityWindow()
+        self.start_streaming()
+        next_report = time.monotonic() + STABLE_REPORT_S
+        down_since = None
+        while True:
+            snap = self._sample_board()
+            now = time.monotonic()
+            down_since = self._check_ports(down_since, now)
+            if snap is not None and snap.skew_ms <= MAX_SKEW_MS:
+                window.add(now, snap.board)
+                board = window.stable(now)
+                if board is not None:
+                    return board
+
+            if now >= next_report:
+                weak = window.weak_squares() if window.samples else []
+                if weak:
+                    log.info("Waiting on %s", ", ".join(f"{name} ({conf:.0%})" for name, conf in weak))
+                next_report = now + STABLE_REPORT_S
+
+            if self.streaming:
+                time.sleep(STREAM_TICK_S)
+
+    def wait_for_stable_board(self, reference, debounce_ms=DEBOUNCE_MS, watch=None,
+                              tracker=None):
+        """
+        Block until the board differs from `reference` and has not changed
+        for debounce_ms. Latency is the sensor settle time plus the window.
+
+        Every sample goes through the per-square SquareFilter first: a
+        vote over polled reads, or a hold time for streamed ones. Only
+        the `watch` squares restart the window; without them, the squares
+        of the legal moves the board could be heading for (from
+        `tracker`), or failing those every square that differs from
+        `reference`. A reader flickering elsewhere cannot hold back the
+        confirmation of a move.
+        """
+        if self.square_filter is None:
+            self.square_filter = SquareFilter(reference)
+        candidate = None
+        cand_watched = None
+        changed_at = 0.0
+        down_since = None
 
-        return full
+        while True:
+            snap = self._sample_board(watch)
+            now = time.monotonic()
+            down_since = self._check_ports(down_since, now)
+
+            # Halves read too far apart may straddle a move; skip them
+            b = None
+            if snap is not None and snap.skew_ms <= MAX_SKEW_MS:
+                if self.streaming:
+                    b = self.square_filter.hold(now, snap.board)
+                else:
+                    b = self.square_filter.add(snap.board)
+
+            if b is not None and b != candidate:
+                squares = watch or (tracker.move_squares(b) if tracker is not None else None)
+                if not squares:
+                    squares = [sq for sq in range(NUM_SQUARES) if b[sq] != reference[sq]]
+                watched = (tuple(squares), bytes(b[sq] for sq in squares))
+                if watched != cand_watched:
+                    # A held push counts from when it first showed
+                    cand_watched = watched
+                    changed_at = (self.square_filter.switched_at or now) if self.streaming else now
+                candidate = b
+
+            if (candidate is not None and candidate != reference
+                    and (now - changed_at) * 1000.0 >= debounce_ms):
+                return candidate
+
+            if self.streaming:
+                time.sleep(STREAM_TICK_S)
 
     # --------------------------------------------------
     # FEN conversion
@@ -250,13 +1338,16 @@ class GameManager:
         return ID_TO_SYMBOL.get(pid, "?")
 
     def board_to_fen(self, raw):
+        if boardcodec is not None:
+            return boardcodec.placement_fen(raw) + " w KQ - 0 1"
+
         rows = []
-        for r in range(8):
-            row = raw[r]
+        for rank in range(7, -1, -1):
+            row = raw[rank * 8:rank * 8 + 8]
             fen_row = ""
             empties = 0
             for cell in row:
-                if cell is None:
+                if cell == EMPTY:
                     empties += 1
                 else:
                     if empties > 0:
@@ -271,120 +1362,277 @@ class GameManager:
     # --------------------------------------------------
     # CACHE LEGAL MOVES
     # --------------------------------------------------
+    @staticmethod
+    def _build_move_index(board):
+        """
+        Index every legal move by the Zobrist hash of the placement it
+        leads to. Each hash is the current one XOR the few squares the move
+        changes, so no board copies or FEN strings are built.
+        """
+        placement = board_placement(board)
+        base = placement_hash(placement)
+
+        index = {}
+        for mv in board.legal_moves:
+            changes = move_changes(board, mv)
+            key = base
+            for sq, pid in changes.items():
+                old = placement[sq]
+                if old != EMPTY:
+                    key ^= zobrist_key(old, sq)
+                if pid != EMPTY:
+                    key ^= zobrist_key(pid, sq)
+            index.setdefault(key, []).append((mv, changes))
+        return index
+
+    def prepare_legal_moves(self):
+        """Start building the index for the current position, if not already."""
+        if self._cache_future is None:
+            self._cache_future = self._cache_pool.submit(
+                self._build_move_index, self.board.copy(stack=False))
+
+    @TRACER.traced("cache_legal_moves")
     def cache_legal_moves(self):
-        self.cached_fens = {}
-        for mv in self.board.legal_moves:
-            temp = self.board.copy()
-            temp.push(mv)
-            fen = temp.fen().split(" ")[0]  # piece placement only
-            self.cached_fens[fen] = mv.uci()
+        """Make the index for the current position available; built once per position."""
+        self.prepare_legal_moves()
+        self.move_index = self._cache_future.result()
+
+    def push_move(self, mv):
+        self.board.push(mv)
+        self._cache_future = None
+        self.tracker = None
+
+    def accept_board(self, board):
+        """Record `board` as the physical position the next move starts from."""
+        self.physical_board = board
+        self.last_stable_board = board
+        self.tracker = None
+        self.square_filter = None
 
     # --------------------------------------------------
     # Detect physical move (new logic)
     # --------------------------------------------------
+    @TRACER.traced("detect")
     def detect_player_move(self):
-        time.sleep(1)
-        new_board = self.assemble_full_board()
-        if new_board is None or new_board == self.physical_board:
-            return None
+        self.start_streaming()
+        if self.tracker is None:
+            self.tracker = MoveTracker(self.physical_board, self.move_index)
 
-        time.sleep(1)
-        confirm = self.assemble_full_board()
-        if confirm is None or confirm != new_board:
-            return None
+        # Follow the move through its intermediate states; only the squares
+        # of the moves still possible are watched until it settles
+        while True:
+            new_board = self.wait_for_stable_board(self.last_stable_board,
+                                                   watch=self.tracker.watch,
+                                                   tracker=self.tracker)
+            self.last_stable_board = new_board
+            state, mv = self.tracker.update(new_board)
+            if state == IN_TRANSIT:
+                log.debug("Move in progress (%d candidates)", len(self.tracker.candidates))
+                continue
+            if state != IDLE:
+                break
 
         # NEW stable board detected
-        print("\n========================")
-        print("NEW STATE DETECTED:")
-        print("========================\n")
-        print_pretty_board(new_board)
-
-        new_fen = self.board_to_fen(new_board).split(" ")[0]
-        print("Detected FEN:", new_fen)
-
-        # Fast path: cached mapping from piece-placement -> UCI
-        if new_fen in self.cached_fens:
-            uci = self.cached_fens[new_fen]
-            self.physical_board = new_board
-            return uci
-
-        # Fallback: brute-force simulate each legal move and compare resulting
-        # piece-placement FEN. This is more robust for multi-piece moves
-        # (castling) or any discrepancy the cache missed.
-        for mv in self.board.legal_moves:
-            temp = self.board.copy()
-            temp.push(mv)
-            sim_fen = temp.fen().split(" ")[0]
-            if sim_fen == new_fen:
-                print(f"Matched by simulation: {mv}")
-                self.physical_board = new_board
-                return mv.uci()
-
-        print("No matching legal move for this new board state.")
+        log.info("New state detected")
+        log.debug("%s", deferred(pretty_board, new_board))
+
+        if mv is not None:
+            self.accept_board(new_board)
+            RECORDER.move(self.nano0.record_source, mv.uci(), "player")
+            return mv.uci()
+
+        log.warning("No matching legal move for this new board state. Detected FEN: %s",
+                    deferred(lambda: self.board_to_fen(new_board).split(" ")[0]))
         return None
 
     # --------------------------------------------------
-    # NEW FUNCTION: WAIT FOR PHYSICAL BOARD TO MATCH ENGINE MOVE
+    # VERIFY THE SQUARES THE COMPUTER'S MOVE CHANGED
     # --------------------------------------------------
-    def wait_until_physical_matches(self, expected_fen, poll_interval=1.0):
+    @TRACER.traced("verify")
+    def wait_until_physical_matches(self, expected, retries=VERIFY_RETRIES,
+                                    interval=VERIFY_INTERVAL_S):
         """
-        Poll Nano every second until the board_to_fen() matches expected_fen.
+        Targeted check after a computer move: `expected` is the move's
+        {square: piece ID} change set (source, destination, castling rook,
+        en passant victim). Only those squares are scanned (read_squares)
+        and compared; the rest are taken from the last accepted board.
+        Returns True once they match, False after `retries` reads.
         """
-        print("\nWaiting for physical board to match engine move...")
-
-        expected = expected_fen.split(" ")[0]
-
-        while True:
-            b = self.assemble_full_board()
-            if b is not None:
-                fen_phys = self.board_to_fen(b).split(" ")[0]
-
-                if fen_phys == expected:
-                    print("Physical board now matches engine move.")
-                    self.physical_board = b
-                    print_pretty_board(b)
-                    return
-
-            time.sleep(poll_interval)
+        log.info("Verifying physical board after engine move...")
+
+        squares = sorted(expected)
+        for attempt in range(retries):
+            values = self.read_squares(squares)
+            if values is not None and values == expected:
+                b = bytearray(self.physical_board)
+                for sq, pid in values.items():
+                    b[sq] = pid
+                b = bytes(b)
+                log.info("Physical board now matches engine move.")
+                self.accept_board(b)
+                log.debug("%s", deferred(pretty_board, b))
+                return True
+            if self.stopping.wait(interval):
+                raise GameStopped()
+
+        return False
 
     # --------------------------------------------------
     # AI move
     # --------------------------------------------------
+    @TRACER.traced("engine")
     def get_ai_move(self):
-        result = self.engine.play(self.board, chess.engine.Limit(time=0.1))
-        return result.move
+        move, self.expected_reply = self.engine.play(self.board)
+        return move
+
+    # --------------------------------------------------
+    # Motion: upload the move, wait for the controller to finish
+    # --------------------------------------------------
+    @TRACER.traced("motion")
+    def run_motion(self, plan):
+        """
+        Upload a plan_move() plan as one batch and block until the motion
+        controller acknowledges it. Returns False if it reported a fault.
+        """
+        self.motion_eta = None
+        if not plan:
+            return True     # left to the player; verification waits for them
+        with self.nano0.lock:
+            seq = self.nano0.next_seq()
+            batched = execute_plan(plan, RECORDER.tap(self.nano0.ser, self.nano0.record_source),
+                                   seq=seq,
+                                   batch=bool(self.motion_caps & CAP_BATCH),
+                                   binary=bool(self.motion_caps & CAP_BINARY))
+            # Unknown until the controller confirms the whole plan
+            expected_s = MOTION_TIME_MARGIN * plan_time(plan, self.head or self.head_guess)
+            end = plan_end(plan, self.head)
+            self.head, self.head_guess = None, end or self.head_guess
+            if not batched:
+                self.motion_eta = time.monotonic() + expected_s
+                return True
+
+            done = self.nano0.wait_motion_done(seq)
+            if done is None:
+                log.warning("No motion acknowledgement; checking the board anyway")
+                return True
+
+            status, steps = done
+            if status != MOTION_OK:
+                log.error("Motion fault 0x%02x after %d steps", status, steps)
+                return False
+            self.head = end
+            return True
+
+    def park_head(self):
+        """
+        Send the empty head towards the source square of the move the
+        pondering search currently prefers. Fire and forget: the player's
+        turn does not wait for it.
+        """
+        guess = self.engine.ponder_guess()
+        if not PARK_HEAD or guess is None:
+            return
+        target = square_pos(guess.from_square)
+        if same_pos(self.head, target) or same_pos(self.head_guess, target):
+            return
+        with self.nano0.lock:
+            send_park(RECORDER.tap(self.nano0.ser, self.nano0.record_source), target,
+                      seq=self.nano0.next_seq(),
+                      batch=bool(self.motion_caps & CAP_BATCH),
+                      binary=bool(self.motion_caps & CAP_BINARY))
+        # Its acknowledgement is dropped, so the head is not known to be there
+        self.head = None
+        self.head_guess = target
 
     # --------------------------------------------------
     # Full gameplay loop
     # --------------------------------------------------
-    def play(self):
-        print("Detecting initial board...")
+    def _log_position(self):
+        if log.isEnabledFor(logging.DEBUG):
+            log.debug("%s", self.board.copy(stack=False))
 
-        while True:
-            b1 = self.assemble_full_board()
-            time.sleep(2)
-            b2 = self.assemble_full_board()
-            if b1 == b2 and b1 is not None:
-                self.physical_board = b1
-                print("\nInitial board detected:")
-                print_pretty_board(b1)
-                break
+    def start_game(self):
+        """Detect the starting position and set self.board from it."""
+        log.info("Detecting initial board...")
+
+        b1 = self.wait_for_initial_board()
+        self.accept_board(b1)
+        log.info("Initial board detected:\n%s", deferred(pretty_board, b1))
 
         init_fen = self.board_to_fen(b1)
-        print("Initial FEN:", init_fen)
+        log.info("Initial FEN: %s", init_fen)
 
         try:
             self.board = chess.Board(init_fen)
         except Exception as e:
-            print("ERROR loading initial FEN:", e)
-            return
+            log.error("ERROR loading initial FEN: %s", e)
+            return False
 
+        self._cache_future = None
+        self.prepare_legal_moves()
         self.current_turn = PLAYER
+        return True
+
+    def play_computer_move(self, mv):
+        """
+        Carry out the computer's move `mv` on the gantry and confirm it on
+        the board. Returns False if it could not be confirmed, even by hand.
+        """
+        uci = mv.uci()
+        RECORDER.move(self.nano0.record_source, uci, "computer")
+
+        # Motion traffic and polled reads share Nano0's port
+        self.stop_streaming()
+
+        # Squares the move changes, for verification afterwards, and
+        # the gantry plan (captures, castling rook, promotion swap)
+        expected = move_changes(self.board, mv)
+        with TRACER.span("plan", move=uci):
+            plan = plan_move(mv, self.board, self.graveyard, head=self.head or self.head_guess)
+
+        # Update internal board state first so the player's legal
+        # moves are indexed while the gantry is still moving
+        self.push_move(mv)
+        self.prepare_legal_moves()
+
+        # Search our next move on the expected reply while the
+        # gantry moves and the player thinks
+        self.engine.start_ponder(self.board, self.expected_reply)
+
+        # Send motion command sequence to Nano0 (motion controller)
+        # NOTE: nano0 is the same device used for board reading;
+        # we are just sending different command bytes here.
+        motion_ok = self.run_motion(plan)
+        self._log_position()
+
+        # Controller says it is done: read back only the moved squares. With
+        # no acknowledgement the gantry may still be moving, so its expected
+        # time is allowed first
+        retries = VERIFY_RETRIES
+        if self.motion_eta is not None:
+            retries += int(max(0.0, self.motion_eta - time.monotonic()) / VERIFY_INTERVAL_S)
+        confirmed = motion_ok and self.wait_until_physical_matches(expected, retries=retries)
+        # Graveyard slots are only known to hold what the plan put there
+        # once the gantry's move is confirmed
+        self.graveyard.commit(plan, confirmed)
+        if not confirmed:
+            log.warning("Gantry did not complete %s; finish it by hand", uci)
+            retries = int(HAND_FIX_S / VERIFY_INTERVAL_S)
+            if not self.wait_until_physical_matches(expected, retries=retries):
+                log.error("Board still does not match the engine; stopping.")
+                return False
+
+        self.park_head()
+        return True
+
+    def play(self):
+        if not self.start_game():
+            return
 
         while not self.board.is_game_over():
 
             if self.current_turn == PLAYER:
-                print("\nWaiting for player's move...")
+                log.info("Waiting for player's move...")
                 self.cache_legal_moves()
                 uci = self.detect_player_move()
 
@@ -392,53 +1640,55 @@ class GameManager:
                     continue
 
                 move = chess.Move.from_uci(uci)
-                print("Player move:", move)
-                self.board.push(move)
-                print(self.board)
+                log.info("Player move: %s", move)
+                self.push_move(move)
+                self._log_position()
                 self.current_turn = COM
 
             else:
-                print("\nComputer thinking...")
+                log.info("Computer thinking...")
                 mv = self.get_ai_move()
-                uci = mv.uci()
-                print("Computer plays:", mv)
-
-                # Send motion command sequence to Nano0 (motion controller)
-                # NOTE: nano0 is the same device used for board reading;
-                # we are just sending different command bytes here.
-                
-                execute_uci_move(uci, self.nano0.ser)
-
-                # Update internal board state
-                self.board.push(mv)
-                print(self.board)
-
-                # NEW: Wait for motion controller / physical board to catch up
-                expected_fen = self.board.fen()
-                self.wait_until_physical_matches(expected_fen)
-
+                log.info("Computer plays: %s", mv)
+                if not self.play_computer_move(mv):
+                    return
                 self.current_turn = PLAYER
 
-        print("\nGame over:", self.board.result())
+        log.info("Game over: %s", self.board.result())
+
+    def stop(self):
+        """Make play() give up from another thread; call quit() after it returns."""
+        self.stopping.set()
 
     def quit(self):
+        self.stop_streaming()
+        for nano in (self.nano0, self.nano1):
+            TRACER.count(f"{nano.label}.crc_errors", nano._parser.crc_errors)
+        TRACER.export()
+        RECORDER.flush()
+        if self._own_io_pool:
+            self._io_pool.shutdown(wait=False)
+        self._cache_pool.shutdown(wait=False)
         self.engine.quit()
-        try:
-            self.nano0.close()
-        except:
-            pass
+        for nano in (self.nano0, self.nano1):
+            try:
+                nano.close()
+            except:
+                pass
 
 
 # --------------------------------------------------
 # MAIN
 # --------------------------------------------------
 if __name__ == "__main__":
-    gm = GameManager(engine_path)
-
-    gm.play()
-    gm.quit()
+    gm = GameManager(engine_path, engine_config)
+    try:
+        gm.play()
+    finally:
+        # Also on Ctrl-C or an error: stop the stream, close the Nanos and
+        # Stockfish, and write out the trace and recording
+        gm.quit()
 
     # while True:
     #     b = gm.assemble_full_board()
-    #     print_pretty_board(b)
+    #     print(pretty_board(b))
     #     time.sleep(1)
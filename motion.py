@@ -15,12 +15,44 @@ Protocol from MotionSystem.hpp:
     MOTION_EMAG_OFF (0x13)
     MOTION_GO_HOME  (0x14)
 
+    MOTION_BATCH (0x15):
+        <0x15><seq><count><count × (ABS or REL packet, ASCII or binary)>
+        The firmware queues the whole path and answers with one
+        FRAME_MOTION_DONE frame (protocol.py) echoing seq once the last
+        step has finished.
+
+    MOTION_BATCH and the binary packets are only sent once Nano0's
+    CMD_HELLO reply (manager.py) lists CAP_BATCH / CAP_BINARY; older
+    firmware gets per-step ASCII packets.
+
+    MOTION_MOVE_ABS_BIN (0x18) / MOTION_MOVE_REL_BIN (0x19):
+        <op><int16 x><int16 y><flags>, little-endian, in MOTION_UNIT_MM
+        units; flags bit 0 = electromagnet on. 6 bytes and no float parsing
+        on the MCU. (0.01 mm would only reach ±327 mm, short of the ~600 mm
+        homing-relative x range, hence 0.1 mm.)
+
 We do NOT open a new serial port — manager.py passes nano0.ser.
+
+plan_move() turns a chess.Move into an ordered list of Segments, one per
+piece carried: captured pieces go to the graveyard (two files left of the
+a-file), castling moves the king then the rook, en passant removes the
+passed pawn, and a promoting pawn is swapped for a spare from the
+graveyard when one is there. execute_plan() sends the whole plan.
 """
 
 from __future__ import annotations
-from dataclasses import dataclass
-from typing import List, Tuple, Protocol, runtime_checkable
+import heapq
+import itertools
+import struct
+from dataclasses import dataclass, field
+from typing import Dict, List, Optional, Tuple, Protocol, runtime_checkable
+
+import chess
+
+import console
+from console import deferred
+
+log = console.logger("motion")
 
 # ----------------------------------------------------------
 # Board geometry
@@ -30,6 +62,7 @@ from typing import List, Tuple, Protocol, runtime_checkable
 SW: float = 57.15 # mm
 
 BOARD_SIZE = 8
+GRAVEYARD_FILES = 2     # columns of slots left of the a-file
 
 
 # ----------------------------------------------------------
@@ -55,124 +88,454 @@ class SerialLike(Protocol):
 
 
 # ----------------------------------------------------------
-# Coordinate conversion
+# Gantry timing model
 # ----------------------------------------------------------
 
-def letter_to_x(letter: str) -> float:
-    i = ord(letter.lower()) - ord("a")
-    return (i + 0.5) * SW
-
-def number_to_y(rank: int) -> float:
-    return (rank - 0.5) * SW
+# Per-axis trapezoidal profile (mm/s, mm/s²) and a fixed cost per
+# segment for the controller to finish one move and start the next
+AXIS_X_SPEED = 150.0
+AXIS_X_ACCEL = 300.0
+AXIS_Y_SPEED = 150.0
+AXIS_Y_ACCEL = 300.0
+SEGMENT_OVERHEAD_S = 0.05
 
-def uci_square_to_pos(sq: str) -> Pos:
-    file = sq[0]
-    rank = int(sq[1])
-    return Pos(letter_to_x(file), number_to_y(rank))
+def axis_time(d: float, vmax: float, accel: float) -> float:
+    d = abs(d)
+    if d * accel < vmax * vmax:            # never reaches vmax: triangle
+        return 2.0 * (d / accel) ** 0.5
+    return d / vmax + vmax / accel
 
-def uci_to_coords(uci: str) -> Tuple[Pos, Pos]:
-    return uci_square_to_pos(uci[:2]), uci_square_to_pos(uci[2:4])
+def segment_time(dx: float, dy: float) -> float:
+    """Both axes run at once, so the slower one sets the segment time."""
+    return SEGMENT_OVERHEAD_S + max(axis_time(dx, AXIS_X_SPEED, AXIS_X_ACCEL),
+                                    axis_time(dy, AXIS_Y_SPEED, AXIS_Y_ACCEL))
 
 
 # ----------------------------------------------------------
-# Corner helpers
+# Lane graph
 # ----------------------------------------------------------
+# Points are kept in half-square units (ints): square and slot centres
+# have odd coordinates, the corners where lanes cross have even ones.
+# A carried piece may
+#   - leave its centre for one of its four corners (and arrive likewise),
+#   - run any distance along a lane between rows or files of squares,
+#   - cut diagonally from corner to corner through empty cells,
+#   - go straight centre to centre when every cell in between is empty.
+# Cells are (file, rank) with negative files for the graveyard.
+
+LANE_U_MIN = -2 * GRAVEYARD_FILES    # leftmost lane: left edge of the graveyard
+LANE_U_MAX = 2 * BOARD_SIZE
+LANE_V_MAX = 2 * BOARD_SIZE
+
+# Route table: every pair of square and slot centres gets up to
+# ROUTE_CANDIDATES routes, fastest first, each with the cells it needs
+# empty as a bitmask (cell_bit); a plan takes the first whose cells are
+# clear. The last candidate runs on lanes only and needs nothing.
+ROUTE_CANDIDATES = 4
+ROUTE_MARGIN = 3        # half-squares beyond the start/end cells a route may use
+
+def to_half_units(p: Pos) -> Tuple[int, int]:
+    return int(round(p.x / (SW / 2))), int(round(p.y / (SW / 2)))
+
+def pos_cell(p: Pos) -> Tuple[int, int]:
+    u, v = to_half_units(p)
+    return (u - 1) // 2, (v - 1) // 2
+
+def cell_bit(cell) -> int:
+    f, r = cell
+    return 1 << ((f + GRAVEYARD_FILES) * BOARD_SIZE + r)
+
+def occupancy_mask(cells) -> int:
+    """Cells (board and graveyard) as a mask of cell_bit()s."""
+    mask = 0
+    for f, r in cells:
+        if -GRAVEYARD_FILES <= f < BOARD_SIZE and 0 <= r < BOARD_SIZE:
+            mask |= cell_bit((f, r))
+    return mask
+
+def _hop_time(a, b) -> float:
+    return segment_time((b[0] - a[0]) * SW / 2, (b[1] - a[1]) * SW / 2)
+
+def _straight_clear(a, b, occupied) -> bool:
+    """Centre-to-centre line along a rank, file or diagonal through empty cells."""
+    du, dv = b[0] - a[0], b[1] - a[1]
+    if not (du == 0 or dv == 0 or abs(du) == abs(dv)):
+        return False
+    n = max(abs(du), abs(dv)) // 2
+    su, sv = (du > 0) - (du < 0), (dv > 0) - (dv < 0)
+    for k in range(1, n):
+        u, v = a[0] + 2 * k * su, a[1] + 2 * k * sv
+        if ((u - 1) // 2, (v - 1) // 2) in occupied:
+            return False
+    return True
+
+def _lane_neighbours(node, end, occupied, bounds):
+    u, v = node
+    umin, umax, vmin, vmax = bounds
+    if abs(u - end[0]) == 1 and abs(v - end[1]) == 1:
+        yield end
+    for uu in range(umin, umax + 1, 2):
+        if uu != u:
+            yield (uu, v)
+    for vv in range(vmin, vmax + 1, 2):
+        if vv != v:
+            yield (u, vv)
+    for su in (-1, 1):
+        for sv in (-1, 1):
+            uu, vv = u, v
+            while True:
+                cell = (min(uu, uu + 2 * su) // 2, min(vv, vv + 2 * sv) // 2)
+                uu, vv = uu + 2 * su, vv + 2 * sv
+                if not (umin <= uu <= umax and vmin <= vv <= vmax):
+                    break
+                if occupied is None or cell in occupied:
+                    break
+                yield (uu, vv)
+
+def _route_bounds(s, e):
+    """
+    Lane crossings a route may use: the box around the start and end
+    cells plus one lane of margin. The lanes-only route always fits
+    inside it; wider detours are never the fastest in practice.
+    """
+    m = ROUTE_MARGIN
+    return (max(LANE_U_MIN, min(s[0], e[0]) - m), min(LANE_U_MAX, max(s[0], e[0]) + m),
+            max(0, min(s[1], e[1]) - m), min(LANE_V_MAX, max(s[1], e[1]) + m))
 
-def square_adjacent_corners(p: Pos) -> List[Pos]:
-    half = SW / 2
-    return [
-        Pos(p.x - half, p.y - half),
-        Pos(p.x + half, p.y - half),
-        Pos(p.x - half, p.y + half),
-        Pos(p.x + half, p.y + half),
-    ]
+def _route(s, e, occupied: Optional[set]):
+    """
+    Dijkstra from `s` to `e` with the cells in `occupied` taken; None
+    takes every cell (lanes only). Returns the route in half-square
+    units and its MotionSteps, both as tuples.
+    """
+    bounds = _route_bounds(s, e)
+    dist = {s: 0.0}
+    prev = {}
+    heap = [(0.0, s)]
+    first_hops = [(s[0] + du, s[1] + dv) for du in (-1, 1) for dv in (-1, 1)]
+    if occupied is not None and _straight_clear(s, e, occupied):
+        first_hops.append(e)
+
+    while heap:
+        t, node = heapq.heappop(heap)
+        if node == e:
+            break
+        if t > dist[node]:
+            continue
+        hops = first_hops if node == s else _lane_neighbours(node, e, occupied, bounds)
+        for nxt in hops:
+            if node == s and not (LANE_U_MIN <= nxt[0] <= LANE_U_MAX and 0 <= nxt[1] <= LANE_V_MAX):
+                continue
+            nt = t + _hop_time(node, nxt)
+            if nt < dist.get(nxt, float("inf")):
+                dist[nxt] = nt
+                prev[nxt] = node
+                heapq.heappush(heap, (nt, nxt))
+
+    route = [e]
+    while route[-1] != s:
+        route.append(prev[route[-1]])
+    route.reverse()
+    steps = tuple(Pos(round((b[0] - a[0]) * SW / 2, 2), round((b[1] - a[1]) * SW / 2, 2))
+                  for a, b in zip(route, route[1:]))
+    return tuple(route), steps
+
+def _route_needs(route) -> set:
+    """Cells a route crosses rather than passes beside: straight runs and diagonal cuts."""
+    needs = set()
+    for a, b in zip(route, route[1:]):
+        du, dv = b[0] - a[0], b[1] - a[1]
+        su, sv = (du > 0) - (du < 0), (dv > 0) - (dv < 0)
+        if a[0] % 2:
+            # From a centre: one hop to a corner, or straight to the end centre
+            for k in range(1, max(abs(du), abs(dv)) // 2):
+                needs.add(((a[0] + 2 * k * su - 1) // 2, (a[1] + 2 * k * sv - 1) // 2))
+        elif du and dv:
+            # Corner to corner (or the last hop onto the end centre)
+            for k in range(abs(du) // 2):
+                u, v = a[0] + 2 * k * su, a[1] + 2 * k * sv
+                needs.add((min(u, u + 2 * su) // 2, min(v, v + 2 * sv) // 2))
+    return needs
+
+def _route_candidates(s, e):
+    """
+    (time, needs mask, steps) for the fastest route with everything
+    empty, then the fastest avoiding every cell the earlier ones cross,
+    and so on; lanes-only last.
+    """
+    candidates = []
+    blocked = set()
+    for _ in range(ROUTE_CANDIDATES - 1):
+        route, steps = _route(s, e, blocked)
+        needs = _route_needs(route)
+        candidates.append((_path_time(route), occupancy_mask(needs), steps))
+        if not needs:
+            return candidates
+        blocked |= needs
+    route, steps = _route(s, e, None)
+    candidates.append((_path_time(route), 0, steps))
+    return candidates
+
+def _path_time(route) -> float:
+    return sum(_hop_time(a, b) for a, b in zip(route, route[1:]))
+
+_ROUTE_TABLE: Dict[Tuple, list] = {}
+_route_table_started = False
+
+def _route_entry(s, e):
+    """The table entry for s -> e, built (with its reverse) on first use."""
+    entry = _ROUTE_TABLE.get((s, e))
+    if entry is None:
+        entry = _route_candidates(s, e)
+        _ROUTE_TABLE[(s, e)] = entry
+        # The lane graph is symmetric: the same routes, run backwards
+        _ROUTE_TABLE[(e, s)] = [(t, needs, tuple(Pos(-p.x, -p.y) for p in reversed(steps)))
+                                for t, needs, steps in entry]
+    return entry
+
+def build_route_table():
+    """
+    Fill the route table for every pair of square and graveyard-slot
+    centres. GameManager runs it in the background at startup; a pair
+    planned before it gets there is built on the spot. Only the first
+    call does any work.
+    """
+    global _route_table_started
+    if _route_table_started:
+        return
+    _route_table_started = True
+    points = ([to_half_units(square_pos(sq)) for sq in range(BOARD_SIZE * BOARD_SIZE)]
+              + [to_half_units(graveyard_slot_pos(i)) for i in range(GRAVEYARD_FILES * BOARD_SIZE)])
+    for i, a in enumerate(points):
+        for b in points[i + 1:]:
+            _route_entry(a, b)
 
-def find_first_corner(start: Pos, end: Pos) -> Pos:
-    corners = square_adjacent_corners(start)
-    return min(corners, key=lambda c: (c.x - end.x)**2 + (c.y - end.y)**2)
+def route_time(route: List[Pos]) -> float:
+    """Gantry time along a list of waypoints; plan_time() uses it for whole plans."""
+    return sum(segment_time(b.x - a.x, b.y - a.y) for a, b in zip(route, route[1:]))
 
-def find_last_corner(start: Pos, end: Pos) -> Pos:
-    corners = square_adjacent_corners(end)
-    return min(corners, key=lambda c: (c.x - start.x)**2 + (c.y - start.y)**2)
 
-def find_closest_corners(start: Pos, end: Pos):
-    return find_first_corner(start, end), find_last_corner(start, end)
+# Where the gantry homes, in board coordinates
+HOME_POS = Pos(-2.5 * SW, 7.5 * SW)
+
+def relative_to_homing(pos: Pos) -> Pos:
+    return Pos(pos.x - HOME_POS.x, pos.y - HOME_POS.y)
+
+def same_pos(a: Optional[Pos], b: Optional[Pos]) -> bool:
+    return a is not None and b is not None and abs(a.x - b.x) < 0.01 and abs(a.y - b.y) < 0.01
 
 
 # ----------------------------------------------------------
-# Path generation
+# Main Planner
 # ----------------------------------------------------------
 
-def to_corner(start: Pos, corner: Pos) -> List[MotionStep]:
-    steps = []
-    dx = corner.x - start.x
-    dy = corner.y - start.y
-    if dy != 0: steps.append(Pos(0, dy))
-    if dx != 0: steps.append(Pos(dx, 0))
-    return steps
+def plan_path(start: Pos, end: Pos, occupied=None) -> List[MotionStep]:
+    """
+    Steps for a carried piece from `start` to `end` (both square or slot
+    centres): the fastest route in the table whose cells are clear.
+    `occupied` is the set of cells holding pieces; None means "treat
+    every cell as occupied" (lanes only).
+    """
+    s, e = to_half_units(start), to_half_units(end)
+    if s == e:
+        return []
+    entry = _route_entry(s, e)
+    if occupied is None:
+        return list(entry[-1][2])
+    mask = occupancy_mask(occupied)
+    for _, needs, steps in entry:
+        if not needs & mask:
+            return list(steps)
 
-def from_corner(corner: Pos, end: Pos) -> List[MotionStep]:
-    steps = []
-    dy = end.y - corner.y
-    dx = end.x - corner.x
-    if dx != 0: steps.append(Pos(dx, 0))
-    if dy != 0: steps.append(Pos(0, dy))
-    return steps
 
-def manhattan(start: Pos, end: Pos) -> List[MotionStep]:
-    steps = []
-    dx = end.x - start.x
-    dy = end.y - start.y
-    if dx != 0: steps.append(Pos(dx, 0))
-    if dy != 0: steps.append(Pos(0, dy))
-    return steps
+# ----------------------------------------------------------
+# Graveyard: off-board slots for captured and spare pieces
+# ----------------------------------------------------------
 
-def concat_steps(steps):
-    if not steps:
-        return steps
-    
-    # Round each step to 2 decimal places
-    steps = [Pos(round(s.x, 2), round(s.y, 2)) for s in steps]
-    
-    merged = [steps[0]]
+# Spare pieces parked in the graveyard before the game, slot index → symbol,
+# e.g. {0: "Q", 8: "q"}; promotions fetch their new piece from here
+SPARE_PIECES: Dict[int, str] = {}
 
-    for s in steps[1:]:
-        last = merged[-1]
-        if last.x != 0 and s.x != 0:      # merge horizontal
-            merged[-1] = Pos(last.x + s.x, last.y)
-        elif last.y != 0 and s.y != 0:    # merge vertical
-            merged[-1] = Pos(last.x, last.y + s.y)
-        else:
-            merged.append(s)
-    
-    # Filter out zero-length steps
-    filtered = [s for s in merged if s.x != 0 or s.y != 0]
-    
-    # If filtering removed steps or we still have mergeable pairs, recurse
-    if len(filtered) < len(merged):
-        return concat_steps(filtered)
-    
-    return filtered
+# A slot a plan used without the motion being confirmed: it may hold
+# anything, so it is neither filled nor fetched from again
+UNKNOWN_PIECE = "?"
 
-def relative_to_homing(pos: Pos) -> Pos:
-    to_homing = (-2.5 * SW, 7.5 * SW)
-    return Pos(pos.x - to_homing[0], pos.y - to_homing[1])
+def graveyard_slot_pos(i: int) -> Pos:
+    col, row = divmod(i, BOARD_SIZE)
+    return Pos(-(col + 0.5) * SW, (row + 0.5) * SW)
+
+class Graveyard:
+    """
+    What each slot holds (a piece symbol, or None). plan_move() only
+    reads it; each Segment names the slot it fills or empties, and
+    commit() records a plan once its motion has been confirmed.
+    """
+
+    def __init__(self, spares: Optional[Dict[int, str]] = None):
+        self.contents: List[Optional[str]] = [None] * (GRAVEYARD_FILES * BOARD_SIZE)
+        for i, sym in (SPARE_PIECES if spares is None else spares).items():
+            self.contents[i] = sym
+
+    def free_slot(self, reserved=()) -> Optional[int]:
+        for i, held in enumerate(self.contents):
+            if held is None and i not in reserved:
+                return i
+        return None
+
+    def find(self, symbol: str) -> Optional[int]:
+        for i, held in enumerate(self.contents):
+            if held == symbol:
+                return i
+        return None
+
+    def commit(self, segments: List[Segment], confirmed: bool = True):
+        """
+        Apply the slots `segments` fill and empty. Unless the motion was
+        confirmed, every slot they touched becomes UNKNOWN_PIECE.
+        """
+        for seg in segments:
+            if seg.slot is not None:
+                self.contents[seg.slot] = seg.slot_piece if confirmed else UNKNOWN_PIECE
 
 
 # ----------------------------------------------------------
-# Main Planner
+# Full-move planner
 # ----------------------------------------------------------
 
-def generate_motion_steps(uci: str):
-    start, end = uci_to_coords(uci)
-    first, last = find_closest_corners(start, end)
+def square_pos(sq: int) -> Pos:
+    return Pos((chess.square_file(sq) + 0.5) * SW, (chess.square_rank(sq) + 0.5) * SW)
 
-    steps = []
-    steps += to_corner(start, first)
-    steps += manhattan(first, last)
-    steps += from_corner(last, end)
+@dataclass
+class Segment:
+    """One piece carried from start to end with the magnet on."""
+    start: Pos
+    end: Pos
+    steps: List[MotionStep]
+    label: str
+    after: List[int] = field(default_factory=list)   # segments that must run first
+    slot: Optional[int] = None          # graveyard slot this segment fills or empties,
+    slot_piece: Optional[str] = None    # and what it holds afterwards (None = empty)
+
+def _segment(start: Pos, end: Pos, label: str, after=(), slot=None, slot_piece=None) -> Segment:
+    return Segment(start, end, [], label, list(after), slot, slot_piece)
+
+def route_segments(segments: List[Segment], board: chess.Board, graveyard: Graveyard):
+    """
+    Fill in each segment's steps. Segments may run in any order, so every
+    cell that holds a piece before, during or after the plan counts as
+    occupied (apart from the cell a segment's own piece leaves).
+    """
+    occupied = {(chess.square_file(sq), chess.square_rank(sq)) for sq in board.piece_map()}
+    occupied |= {pos_cell(graveyard_slot_pos(i)) for i, held in enumerate(graveyard.contents) if held}
+    for seg in segments:
+        occupied |= {pos_cell(seg.start), pos_cell(seg.end)}
+    for seg in segments:
+        seg.steps = plan_path(seg.start, seg.end, occupied - {pos_cell(seg.start)})
+
+def empty_travel(a: Pos, b: Pos) -> float:
+    # Straight move with the magnet off; both axes run at once
+    return segment_time(a.x - b.x, a.y - b.y)
+
+def order_segments(segments: List[Segment], head: Optional[Pos] = None) -> List[Segment]:
+    """
+    Order segments to minimise empty (magnet off) travel between them,
+    starting from the gantry head position if known, keeping every
+    segment after the ones listed in its `after`.
+    """
+    best, best_cost = segments, None
+    for order in itertools.permutations(range(len(segments))):
+        seen = set()
+        valid = True
+        for i in order:
+            if any(dep not in seen for dep in segments[i].after):
+                valid = False
+                break
+            seen.add(i)
+        if not valid:
+            continue
+
+        cost, pos = 0.0, head
+        for i in order:
+            if pos is not None:
+                cost += empty_travel(pos, segments[i].start)
+            pos = segments[i].end
+        if best_cost is None or cost < best_cost:
+            best, best_cost = [segments[i] for i in order], cost
+    return best
+
+def plan_move(move: chess.Move, board: chess.Board, graveyard: Graveyard,
+              head: Optional[Pos] = None) -> List[Segment]:
+    """
+    Ordered multi-piece plan for a legal `move` on `board` (the position
+    before the move). `graveyard` is not changed; pass the plan to its
+    commit() once the motion is confirmed. With no free slot for a
+    capture the whole move is left to the player (an empty plan), as a
+    promotion without a spare leaves the new piece to them.
+    """
+    piece = board.piece_at(move.from_square)
+    src, dst = square_pos(move.from_square), square_pos(move.to_square)
+    segments: List[Segment] = []
+
+    if board.is_castling(move):
+        rank = chess.square_rank(move.from_square)
+        kingside = board.is_kingside_castling(move)
+        king_to = chess.square(6 if kingside else 2, rank)
+        rook_from = chess.square(7 if kingside else 0, rank)
+        rook_to = chess.square(5 if kingside else 3, rank)
+        segments.append(_segment(src, square_pos(king_to), "king"))
+        segments.append(_segment(square_pos(rook_from), square_pos(rook_to), "rook", after=[0]))
+        route_segments(segments, board, graveyard)
+        return order_segments(segments, head)
+
+    # Captured piece leaves first so its square (or lane) is clear
+    if board.is_en_passant(move):
+        victim_sq = chess.square(chess.square_file(move.to_square), chess.square_rank(move.from_square))
+    else:
+        victim_sq = move.to_square if board.piece_at(move.to_square) else None
+    capture = []
+    reserved = []
+    if victim_sq is not None:
+        victim = board.piece_at(victim_sq)
+        slot = graveyard.free_slot()
+        if slot is None:
+            log.warning("[motion] Graveyard is full; take the %s off %s and play %s by hand",
+                        victim.symbol(), chess.square_name(victim_sq), move.uci())
+            return []
+        segments.append(_segment(square_pos(victim_sq), graveyard_slot_pos(slot), "capture",
+                                 slot=slot, slot_piece=victim.symbol()))
+        capture = [0]
+        reserved.append(slot)
+
+    if move.promotion:
+        # The pawn goes straight to the graveyard; a spare takes its place
+        new_symbol = chess.Piece(move.promotion, piece.color).symbol()
+        spare = graveyard.find(new_symbol)
+        slot = graveyard.free_slot(reserved)
+        pawn_out = None
+        if slot is not None:
+            pawn_out = len(segments)
+            segments.append(_segment(src, graveyard_slot_pos(slot), "pawn out",
+                                     slot=slot, slot_piece=piece.symbol()))
+        if spare is not None:
+            promotion = len(segments)
+            segments.append(_segment(graveyard_slot_pos(spare), dst, "promotion", slot=spare,
+                                     after=capture + ([] if pawn_out is None else [pawn_out])))
+            if slot is None:
+                # Full graveyard: the pawn takes the slot the spare leaves
+                segments.append(_segment(src, graveyard_slot_pos(spare), "pawn out", after=[promotion],
+                                         slot=spare, slot_piece=piece.symbol()))
+        else:
+            log.warning("[motion] No spare %s in the graveyard; place it on %s by hand",
+                        new_symbol, chess.square_name(move.to_square))
+            if slot is None:
+                log.warning("[motion] Graveyard is full; take the pawn off %s by hand",
+                            chess.square_name(move.from_square))
+        route_segments(segments, board, graveyard)
+        return order_segments(segments, head)
 
-    return start, concat_steps(steps)
+    segments.append(_segment(src, dst, "move", after=capture))
+    route_segments(segments, board, graveyard)
+    return order_segments(segments, head)
 
 
 # ----------------------------------------------------------
@@ -184,52 +547,140 @@ MOTION_MOVE_REL = 0x11
 MOTION_EMAG_ON  = 0x12
 MOTION_EMAG_OFF = 0x13
 MOTION_GO_HOME  = 0x14
+MOTION_BATCH    = 0x15
+
+MOTION_MOVE_ABS_BIN = 0x18
+MOTION_MOVE_REL_BIN = 0x19
+
+MAX_BATCH_STEPS = 255
+
+MOTION_UNIT_MM = 0.1
+FLAG_MAG = 0x01
+_BIN_PACKET = struct.Struct("<BhhB")
+
 
+def _encode_bin(op: int, p: Pos, useMag: int) -> bytes:
+    try:
+        return _BIN_PACKET.pack(op, round(p.x / MOTION_UNIT_MM), round(p.y / MOTION_UNIT_MM),
+                                FLAG_MAG if useMag else 0)
+    except struct.error:
+        raise ValueError(f"motion target out of int16 range: {p}")
 
-def send_abs(port: SerialLike, pos: Pos, useMag: int = 0):
+
+def encode_abs(pos: Pos, useMag: int = 0, binary: bool = False) -> bytes:
     """
-    Send: 0x10 + "x y useMag\n"
+    0x10 + "x y useMag\n", or the 6-byte MOTION_MOVE_ABS_BIN packet
     """
+    if binary:
+        return _encode_bin(MOTION_MOVE_ABS_BIN, pos, useMag)
     x, y = pos.as_int_tuple()
-    packet = f"{x} {y} {useMag}\n".encode()
-    port.write(bytes([MOTION_MOVE_ABS]) + packet)
-    port.flush()
-    print("[motion] ABS:", packet.decode().strip())
+    return bytes([MOTION_MOVE_ABS]) + f"{x} {y} {useMag}\n".encode()
 
 
-def send_rel(port: SerialLike, step: Pos, useMag: int = 1):
+def encode_rel(step: Pos, useMag: int = 1, binary: bool = False) -> bytes:
     """
-    Send: 0x11 + "dx dy useMag\n"
+    0x11 + "dx dy useMag\n", or the 6-byte MOTION_MOVE_REL_BIN packet
     """
+    if binary:
+        return _encode_bin(MOTION_MOVE_REL_BIN, step, useMag)
     dx, dy = step.as_int_tuple()
-    packet = f"{dx} {dy} {useMag}\n".encode()
-    port.write(bytes([MOTION_MOVE_REL]) + packet)
-    port.flush()
-    print("[motion] REL:", packet.decode().strip())
+    return bytes([MOTION_MOVE_REL]) + f"{dx} {dy} {useMag}\n".encode()
+
 
+def describe_packet(packet: bytes) -> str:
+    if packet[0] in (MOTION_MOVE_ABS_BIN, MOTION_MOVE_REL_BIN):
+        _, x, y, flags = _BIN_PACKET.unpack(packet)
+        return f"{x * MOTION_UNIT_MM:.1f} {y * MOTION_UNIT_MM:.1f} {flags & FLAG_MAG}"
+    return packet[1:].decode().strip()
 
-def execute_uci_move(uci: str, port: SerialLike):
+
+def send_batch(port: SerialLike, packets: List[bytes], seq: int):
     """
-    Execute full motion for a UCI move using the Nano ASCII-float protocol.
+    Send: 0x15 + seq + count + packets, in a single write and flush.
     """
-    print(f"[motion] Executing: {uci}")
-
-    start_abs, steps = generate_motion_steps(uci)
-    start_rel = relative_to_homing(start_abs)
+    if len(packets) > MAX_BATCH_STEPS:
+        raise ValueError(f"motion batch too long: {len(packets)} steps")
+    port.write(bytes([MOTION_BATCH, seq & 0xFF, len(packets)]) + b"".join(packets))
+    port.flush()
+    log.debug("[motion] BATCH #%d: %d steps", seq & 0xFF, len(packets))
 
-    # 1. Move ABSOLUTELY to start square center
-    send_abs(port, start_rel, useMag=0)
 
-    # 2. Perform relative moves
-    for s in steps:
-        send_rel(port, s, useMag=1)
+def plan_packets(segments: List[Segment], binary: bool = False) -> List[bytes]:
+    """
+    Packets for a plan. Every segment starts with its magnet-off approach,
+    even if the head should already be there: a lost park or a jammed
+    batch must never turn the next REL steps into a drag from elsewhere,
+    and an ABS to where the head stands costs next to nothing.
+    """
+    packets = []
+    for seg in segments:
+        # Magnet off to the segment start, then carry the piece
+        packets.append(encode_abs(relative_to_homing(seg.start), useMag=0, binary=binary))
+        packets += [encode_rel(s, useMag=1, binary=binary) for s in seg.steps]
+    return packets
+
+def plan_end(segments: List[Segment], head: Optional[Pos] = None) -> Optional[Pos]:
+    """Where the head stops once `segments` have run."""
+    return segments[-1].end if segments else head
+
+def plan_time(segments: List[Segment], head: Optional[Pos] = None) -> float:
+    """Expected gantry time for a plan under the timing model, from `head` if known."""
+    route = [] if head is None else [head]
+    for seg in segments:
+        p = seg.start
+        route.append(p)
+        for s in seg.steps:
+            p = Pos(p.x + s.x, p.y + s.y)
+            route.append(p)
+    return route_time(route)
+
+
+def execute_plan(segments: List[Segment], port: SerialLike, seq: int = 0,
+                 batch: bool = False, binary: bool = False):
+    """
+    Send every segment of a plan_move() plan; as one MOTION_BATCH when
+    `batch` is set (returns True, a FRAME_MOTION_DONE with `seq` follows).
+    """
+    log.info("[motion] Executing plan: %s", ", ".join(seg.label for seg in segments))
+    packets = plan_packets(segments, binary)
+    if batch:
+        send_batch(port, packets, seq)
+        return True
+
+    for p in packets:
+        port.write(p)
+        port.flush()
+        log.debug("[motion] %s %s", "ABS:" if p[0] in (MOTION_MOVE_ABS, MOTION_MOVE_ABS_BIN) else "REL:",
+                  deferred(describe_packet, p))
+    return False
+
+
+def send_park(port: SerialLike, pos: Pos, seq: int = 0,
+              batch: bool = False, binary: bool = False):
+    """
+    Move the empty head to `pos` (magnet off), e.g. under the piece the
+    computer will probably move next. Nothing waits for it: a batched
+    park's FRAME_MOTION_DONE is simply dropped by sequence number, and
+    the controller finishes it before the next plan starts.
+    """
+    packet = encode_abs(relative_to_homing(pos), useMag=0, binary=binary)
+    log.debug("[motion] Park: %s", deferred(describe_packet, packet))
+    if batch:
+        send_batch(port, [packet], seq)
+    else:
+        port.write(packet)
+        port.flush()
 
 
 if __name__ == "__main__":
     # Testing script
-    uci = "e7e6"
-    start_abs, steps = generate_motion_steps(uci)
-    start_rel = relative_to_homing(start_abs)
-    print("Start rel:", start_rel)
-    for step in steps:
-        print(step)
\ No newline at end of file
+    board = chess.Board()
+    for seg in plan_move(chess.Move.from_uci("g1f3"), board, Graveyard()):
+        print(seg.label, "start rel:", relative_to_homing(seg.start))
+        for step in seg.steps:
+            print(step)
+
+    # Castling plan: king, then rook
+    board = chess.Board("r3k2r/8/8/8/8/8/8/R3K2R b KQkq - 0 1")
+    for seg in plan_move(chess.Move.from_uci("e8g8"), board, Graveyard()):
+        print(seg.label, seg.start, "->", seg.end)
\ No newline at end of file
@@ -0,0 +1,191 @@
+// boardcodec.cpp — native board decoding for manager.py
+//
+// Takes the two 32-byte Nano blocks straight from the serial layer (any
+// buffer-protocol object, no copy) and returns the flat 64-square board
+// plus its Zobrist placement hash. The square permutation and the Zobrist
+// keys are handed over once by manager.py through configure(), so the
+// reader maps and hash keys have a single source of truth in Python.
+//
+//   configure(square_to_raw: 64 bytes, zobrist: 14*64 little-endian u64)
+//   decode(left, right)      -> (bytes[64] board, int hash)
+//   placement_hash(board)    -> int
+//   placement_fen(board)     -> str   (piece-placement field only)
+
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+
+#include <array>
+#include <cstdint>
+
+namespace {
+
+constexpr Py_ssize_t kBlockBytes = 32;
+constexpr Py_ssize_t kSquares = 64;
+constexpr int kKeyKinds = 14;  // EMPTY, piece IDs 1..12, unknown ID
+constexpr int kUnknownKind = 13;
+
+std::array<uint8_t, kSquares> g_square_to_raw{};
+std::array<uint64_t, kKeyKinds * kSquares> g_zobrist{};
+bool g_configured = false;
+
+// Index = piece ID (see ID_TO_SYMBOL in manager.py)
+constexpr char kSymbols[] = ".PRNBQKprnbqk";
+
+// Py_buffer that is released on scope exit
+class BufferView {
+ public:
+  explicit BufferView(PyObject* obj) {
+    ok_ = PyObject_GetBuffer(obj, &view_, PyBUF_SIMPLE) == 0;
+  }
+  ~BufferView() {
+    if (ok_) PyBuffer_Release(&view_);
+  }
+  BufferView(const BufferView&) = delete;
+  BufferView& operator=(const BufferView&) = delete;
+
+  bool ok() const { return ok_; }
+  Py_ssize_t size() const { return view_.len; }
+  const uint8_t* data() const { return static_cast<const uint8_t*>(view_.buf); }
+
+ private:
+  Py_buffer view_{};
+  bool ok_ = false;
+};
+
+inline int zobrist_kind(uint8_t pid) {
+  return pid <= 12 ? pid : kUnknownKind;
+}
+
+uint64_t hash_board(const uint8_t* board) {
+  uint64_t h = 0;
+  for (Py_ssize_t sq = 0; sq < kSquares; ++sq) {
+    if (board[sq]) h ^= g_zobrist[zobrist_kind(board[sq]) * kSquares + sq];
+  }
+  return h;
+}
+
+bool check_configured() {
+  if (!g_configured) {
+    PyErr_SetString(PyExc_RuntimeError, "boardcodec.configure() has not been called");
+    return false;
+  }
+  return true;
+}
+
+bool check_size(const BufferView& buf, Py_ssize_t expected, const char* what) {
+  if (!buf.ok()) return false;
+  if (buf.size() != expected) {
+    PyErr_Format(PyExc_ValueError, "%s must be %zd bytes, got %zd", what, expected, buf.size());
+    return false;
+  }
+  return true;
+}
+
+PyObject* configure(PyObject*, PyObject* args) {
+  PyObject *perm_obj, *keys_obj;
+  if (!PyArg_ParseTuple(args, "OO", &perm_obj, &keys_obj)) return nullptr;
+
+  BufferView perm(perm_obj);
+  BufferView keys(keys_obj);
+  if (!check_size(perm, kSquares, "square_to_raw")) return nullptr;
+  if (!check_size(keys, kKeyKinds * kSquares * 8, "zobrist")) return nullptr;
+
+  for (Py_ssize_t sq = 0; sq < kSquares; ++sq) {
+    if (perm.data()[sq] >= 2 * kBlockBytes) {
+      PyErr_SetString(PyExc_ValueError, "square_to_raw entry out of range");
+      return nullptr;
+    }
+    g_square_to_raw[sq] = perm.data()[sq];
+  }
+
+  const uint8_t* k = keys.data();
+  for (size_t i = 0; i < g_zobrist.size(); ++i, k += 8) {
+    uint64_t v = 0;
+    for (int b = 7; b >= 0; --b) v = (v << 8) | k[b];
+    g_zobrist[i] = v;
+  }
+
+  g_configured = true;
+  Py_RETURN_NONE;
+}
+
+PyObject* decode(PyObject*, PyObject* args) {
+  PyObject *left_obj, *right_obj;
+  if (!PyArg_ParseTuple(args, "OO", &left_obj, &right_obj)) return nullptr;
+  if (!check_configured()) return nullptr;
+
+  BufferView left(left_obj);
+  BufferView right(right_obj);
+  if (!check_size(left, kBlockBytes, "left block")) return nullptr;
+  if (!check_size(right, kBlockBytes, "right block")) return nullptr;
+
+  PyObject* out = PyBytes_FromStringAndSize(nullptr, kSquares);
+  if (!out) return nullptr;
+  auto* board = reinterpret_cast<uint8_t*>(PyBytes_AS_STRING(out));
+
+  for (Py_ssize_t sq = 0; sq < kSquares; ++sq) {
+    const uint8_t raw = g_square_to_raw[sq];
+    board[sq] = raw < kBlockBytes ? left.data()[raw] : right.data()[raw - kBlockBytes];
+  }
+
+  return Py_BuildValue("(NK)", out, static_cast<unsigned long long>(hash_board(board)));
+}
+
+PyObject* placement_hash(PyObject*, PyObject* arg) {
+  if (!check_configured()) return nullptr;
+  BufferView board(arg);
+  if (!check_size(board, kSquares, "board")) return nullptr;
+  return PyLong_FromUnsignedLongLong(hash_board(board.data()));
+}
+
+PyObject* placement_fen(PyObject*, PyObject* arg) {
+  BufferView board(arg);
+  if (!check_size(board, kSquares, "board")) return nullptr;
+
+  char fen[8 * 9];
+  size_t n = 0;
+  for (int rank = 7; rank >= 0; --rank) {
+    int empties = 0;
+    for (int file = 0; file < 8; ++file) {
+      const uint8_t pid = board.data()[rank * 8 + file];
+      if (pid == 0) {
+        ++empties;
+        continue;
+      }
+      if (empties) {
+        fen[n++] = static_cast<char>('0' + empties);
+        empties = 0;
+      }
+      fen[n++] = pid <= 12 ? kSymbols[pid] : '?';
+    }
+    if (empties) fen[n++] = static_cast<char>('0' + empties);
+    if (rank) fen[n++] = '/';
+  }
+  return PyUnicode_FromStringAndSize(fen, static_cast<Py_ssize_t>(n));
+}
+
+PyMethodDef kMethods[] = {
+    {"configure", configure, METH_VARARGS, "configure(square_to_raw, zobrist_keys)"},
+    {"decode", decode, METH_VARARGS, "decode(left, right) -> (board, hash)"},
+    {"placement_hash", placement_hash, METH_O, "placement_hash(board) -> int"},
+    {"placement_fen", placement_fen, METH_O, "placement_fen(board) -> str"},
+    {nullptr, nullptr, 0, nullptr},
+};
+
+PyModuleDef kModule = {
+    PyModuleDef_HEAD_INIT,
+    "boardcodec",
+    "Native board decoding for manager.py",
+    -1,
+    kMethods,
+    nullptr,
+    nullptr,
+    nullptr,
+    nullptr,
+};
+
+}  // namespace
+
+PyMODINIT_FUNC PyInit_boardcodec() {
+  return PyModule_Create(&kModule);
+}
@@ -0,0 +1,198 @@
+"""
+protocol.py — framed binary protocol shared by the board and motion Nanos.
+
+Every framed reply from the firmware looks like:
+
+    <SOF 0xA5><VER><TYPE><SEQ><LEN><payload: LEN bytes><CRC16 hi><CRC16 lo>
+
+    SOF   start of frame; piece IDs never reach 0xA5, but a CRC match is
+          still required before a frame is trusted
+    VER   PROTOCOL_VERSION; frames from another version are dropped
+    TYPE  FRAME_* below
+    SEQ   echoes the sequence byte of the request that produced the frame
+          (stream pushes carry the firmware's own running counter)
+    CRC   CRC-16/CCITT-FALSE over VER..payload
+
+FRAME_BLOCK payload:
+
+    <status: 4 bytes, little-endian bitmap, bit i set = reader i was read>
+    <32 bytes: one piece ID per reader, 0 = empty>
+
+FRAME_MOTION_DONE payload (answers a MOTION_BATCH, see motion.py):
+
+    <status: MOTION_OK or a firmware fault code><steps completed>
+
+FRAME_CAPS payload (answers CMD_HELLO, manager.py; SEQ is 0):
+
+    <capability bitmap: CAP_*>
+
+CMD_HELLO is a single byte, which legacy firmware ignores; it stays
+silent and every CAP_* is taken as clear. The host sends no multi-byte
+command a Nano has not listed: legacy firmware would read the trailing
+bytes as commands of their own (a sequence number of 0x14 is
+MOTION_GO_HOME, 0x01 a raw CMD_GET_BLOCK).
+
+FRAME_CHANNELS payload (answers CMD_GET_CHANNELS, manager.py):
+
+    <mask: 4 bytes, little-endian, the channels that were asked for>
+    <status: 4 bytes, little-endian bitmap as in FRAME_BLOCK>
+    <one piece ID per set mask bit, lowest channel first>
+
+The parser resynchronises on SOF, so motion traffic or a torn frame on the
+same port costs only the bytes involved, never the next good frame.
+"""
+
+from __future__ import annotations
+from dataclasses import dataclass
+from typing import List
+
+SOF = 0xA5
+PROTOCOL_VERSION = 0x01
+
+FRAME_BLOCK       = 0x01
+FRAME_MOTION_DONE = 0x02
+FRAME_CAPS        = 0x03
+FRAME_CHANNELS    = 0x04
+
+MOTION_OK = 0x00
+
+# Capabilities reported in FRAME_CAPS
+CAP_BATCH    = 0x01  # motion: MOTION_BATCH + FRAME_MOTION_DONE
+CAP_BINARY   = 0x02  # motion: fixed-point MOTION_*_BIN packets
+CAP_FRAMED   = 0x04  # CMD_GET_FRAME
+CAP_CHANNELS = 0x08  # CMD_GET_CHANNELS
+CAP_STREAM   = 0x10  # CMD_STREAM
+CAP_NAMES = ((CAP_FRAMED, "framed"), (CAP_CHANNELS, "channels"), (CAP_STREAM, "stream"),
+             (CAP_BATCH, "batch"), (CAP_BINARY, "binary"))
+
+HEADER_BYTES = 5          # SOF, VER, TYPE, SEQ, LEN
+CRC_BYTES = 2
+MAX_PAYLOAD = 64
+
+STATUS_BYTES = 4
+
+
+# ----------------------------------------------------------
+# CRC-16/CCITT-FALSE (poly 0x1021, init 0xFFFF)
+# ----------------------------------------------------------
+
+def _make_crc_table():
+    table = []
+    for i in range(256):
+        crc = i << 8
+        for _ in range(8):
+            crc = ((crc << 1) ^ 0x1021) if crc & 0x8000 else (crc << 1)
+        table.append(crc & 0xFFFF)
+    return table
+
+_CRC_TABLE = _make_crc_table()
+
+def crc16(data, crc: int = 0xFFFF) -> int:
+    for b in data:
+        crc = ((crc << 8) & 0xFFFF) ^ _CRC_TABLE[((crc >> 8) ^ b) & 0xFF]
+    return crc
+
+
+# ----------------------------------------------------------
+# Frames
+# ----------------------------------------------------------
+
+@dataclass
+class Frame:
+    type: int
+    seq: int
+    payload: bytes
+
+
+def encode_frame(ftype: int, seq: int, payload: bytes) -> bytes:
+    body = bytes([PROTOCOL_VERSION, ftype, seq & 0xFF, len(payload)]) + bytes(payload)
+    crc = crc16(body)
+    return bytes([SOF]) + body + bytes([crc >> 8, crc & 0xFF])
+
+
+def decode_block_payload(payload: bytes):
+    """
+    Split a FRAME_BLOCK payload into (status_bitmap, list of reader values).
+    Returns None if the payload has the wrong size.
+    """
+    if len(payload) <= STATUS_BYTES:
+        return None
+    status = int.from_bytes(payload[:STATUS_BYTES], "little")
+    return status, list(payload[STATUS_BYTES:])
+
+
+def encode_block_payload(status: int, values) -> bytes:
+    return status.to_bytes(STATUS_BYTES, "little") + bytes(values)
+
+
+def decode_channels_payload(payload: bytes):
+    """
+    Split a FRAME_CHANNELS payload into (mask, status_bitmap, {channel: value}).
+    Returns None if the value count does not match the mask.
+    """
+    if len(payload) < 2 * STATUS_BYTES:
+        return None
+    mask = int.from_bytes(payload[:STATUS_BYTES], "little")
+    status = int.from_bytes(payload[STATUS_BYTES:2 * STATUS_BYTES], "little")
+    channels = [i for i in range(8 * STATUS_BYTES) if (mask >> i) & 1]
+    values = payload[2 * STATUS_BYTES:]
+    if len(values) != len(channels):
+        return None
+    return mask, status, dict(zip(channels, values))
+
+
+def encode_channels_payload(mask: int, status: int, values) -> bytes:
+    """`values` holds one piece ID per set mask bit, lowest channel first."""
+    return (mask.to_bytes(STATUS_BYTES, "little") + status.to_bytes(STATUS_BYTES, "little")
+            + bytes(values))
+
+
+class FrameParser:
+    """
+    Incremental frame decoder. feed() takes whatever bytes arrived and
+    returns every complete, CRC-valid frame found so far.
+    """
+
+    def __init__(self):
+        self.buf = bytearray()
+        self.crc_errors = 0
+
+    def reset(self):
+        self.buf.clear()
+
+    def feed(self, data) -> List[Frame]:
+        if data:
+            self.buf += data
+
+        frames = []
+        buf = self.buf
+        while True:
+            start = buf.find(SOF)
+            if start < 0:
+                buf.clear()
+                break
+            if start:
+                del buf[:start]
+            if len(buf) < HEADER_BYTES:
+                break
+
+            ver, ftype, seq, length = buf[1], buf[2], buf[3], buf[4]
+            if ver != PROTOCOL_VERSION or length > MAX_PAYLOAD:
+                del buf[0]
+                continue
+
+            total = HEADER_BYTES + length + CRC_BYTES
+            if len(buf) < total:
+                break
+
+            crc = (buf[total - 2] << 8) | buf[total - 1]
+            if crc16(buf[1:total - 2]) != crc:
+                # Not a frame after all (or a corrupt one); rescan past SOF
+                self.crc_errors += 1
+                del buf[0]
+                continue
+
+            frames.append(Frame(ftype, seq, bytes(buf[HEADER_BYTES:HEADER_BYTES + length])))
+            del buf[:total]
+
+        return frames
@@ -0,0 +1,303 @@
+"""
+recorder.py — append-only binary log of everything the Nanos report.
+
+Every block a SerialNano receives (polled, raw or pushed), every partial
+channel scan, every motion packet sent and every move accepted goes to
+one file, so a game can be replayed offline through decode_board() and
+the detector without the board attached.
+
+Enabled from the `record:` section of config.yaml:
+
+    record:
+      path: games.rec        # appended to; one session per start
+
+File layout (little-endian):
+
+    file    <MAGIC 8 bytes> then records, to the end of the file
+    record  <type u8><source u8><t f64><len u16><payload: len bytes>
+
+    t       seconds since the session started (REC_SESSION)
+    source  a REC_SOURCE id; 0 for session records
+
+    REC_SESSION   <wall clock f64>; source ids restart from here
+    REC_SOURCE    <half u8><board name>\\0<Nano label>; `source` is its id
+    REC_BLOCK     <32 piece IDs>, as get_block() returned them
+    REC_CHANNELS  <mask u32><one piece ID per set bit, lowest first>
+    REC_MOTION    bytes written to the motion controller, one write each
+    REC_MOVE      <UCI><\\0><"player" | "computer">
+
+A record costs one struct.pack and a buffered write; disabled, every call
+is a flag check. Read back with RecordLog (mmap, zero-copy payloads) or:
+
+    python recorder.py games.rec              # summary per session
+    python recorder.py games.rec --boards     # every distinct decoded board
+"""
+
+from __future__ import annotations
+
+import mmap
+import struct
+import sys
+import threading
+import time
+from dataclasses import dataclass
+
+import console
+
+log = console.logger("recorder")
+
+MAGIC = b"CMREC\x00\x01\x00"
+
+REC_SESSION  = 0x00
+REC_SOURCE   = 0x01
+REC_BLOCK    = 0x02
+REC_CHANNELS = 0x03
+REC_MOTION   = 0x04
+REC_MOVE     = 0x05
+
+_HEADER = struct.Struct("<BBdH")
+_WALL = struct.Struct("<d")
+_MASK = struct.Struct("<I")
+
+WRITE_BUFFER = 64 * 1024
+MAX_SOURCES = 255
+
+
+class Recorder:
+    def __init__(self):
+        self.enabled = False
+        self.path = None
+        self._f = None
+        self._lock = threading.Lock()
+        self._t0 = 0.0
+        self._sources = 0
+
+    def configure(self, cfg):
+        cfg = cfg or {}
+        self.path = cfg.get("path")
+        self.enabled = self.path is not None
+
+    def _open(self):
+        self._f = open(self.path, "ab", buffering=WRITE_BUFFER)
+        if self._f.tell() == 0:
+            self._f.write(MAGIC)
+        self._t0 = time.monotonic()
+        self._f.write(_HEADER.pack(REC_SESSION, 0, 0.0, _WALL.size) + _WALL.pack(time.time()))
+        log.info("[record] appending to %s", self.path)
+
+    def _write(self, rtype, source, payload):
+        with self._lock:
+            if self._f is None:
+                return
+            self._f.write(_HEADER.pack(rtype, source, time.monotonic() - self._t0, len(payload)))
+            self._f.write(payload)
+
+    # --------------------------------------------------
+    # Recording
+    # --------------------------------------------------
+    def register(self, nano, half, board=""):
+        """Give `nano` a source id; it records its reads from then on."""
+        if not self.enabled:
+            return
+        with self._lock:
+            if self._f is None:
+                self._open()
+            if self._sources == MAX_SOURCES:
+                raise Exception(f"record: more than {MAX_SOURCES} Nanos in one session")
+            self._sources += 1
+            nano.record_source = self._sources
+        payload = bytes([half]) + f"{board}\0{nano.label}".encode()
+        self._write(REC_SOURCE, nano.record_source, payload)
+
+    def block(self, source, data):
+        if self.enabled and source:
+            self._write(REC_BLOCK, source, data)
+
+    def channels(self, source, mask, values):
+        if self.enabled and source:
+            self._write(REC_CHANNELS, source, _MASK.pack(mask) + bytes(values))
+
+    def move(self, source, uci, side):
+        if self.enabled and source:
+            self._write(REC_MOVE, source, f"{uci}\0{side}".encode())
+
+    def tap(self, port, source):
+        """`port`, with every write also recorded as REC_MOTION."""
+        if not (self.enabled and source):
+            return port
+        return _MotionTap(self, port, source)
+
+    def flush(self):
+        with self._lock:
+            if self._f is not None:
+                self._f.flush()
+
+    def close(self):
+        with self._lock:
+            if self._f is not None:
+                self._f.close()
+                self._f = None
+
+
+class _MotionTap:
+    """The write/flush side of a SerialLike, for motion.py's senders."""
+
+    def __init__(self, recorder, port, source):
+        self._recorder = recorder
+        self._port = port
+        self._source = source
+
+    def write(self, data):
+        self._recorder._write(REC_MOTION, self._source, bytes(data))
+        return self._port.write(data)
+
+    def flush(self):
+        self._port.flush()
+
+
+RECORDER = Recorder()
+
+
+# --------------------------------------------------
+# Reading
+# --------------------------------------------------
+@dataclass
+class Record:
+    type: int
+    source: int
+    t: float
+    payload: memoryview
+
+
+@dataclass
+class Source:
+    half: int
+    board: str
+    label: str
+
+
+class RecordLog:
+    """
+    A recording, memory-mapped. Iterating yields (session, Record) in
+    file order; payloads are views into the map, valid while it is open.
+    `sessions[i]` maps source ids to Source for session i.
+    """
+
+    def __init__(self, path):
+        self._file = open(path, "rb")
+        self._map = mmap.mmap(self._file.fileno(), 0, access=mmap.ACCESS_READ)
+        if self._map[:len(MAGIC)] != MAGIC:
+            self.close()
+            raise Exception(f"{path}: not a recording")
+        self.sessions = []
+        self.truncated = False
+
+    def __iter__(self):
+        view = memoryview(self._map)
+        end = len(view)
+        pos = len(MAGIC)
+        session = -1
+        self.sessions = []
+        while pos + _HEADER.size <= end:
+            rtype, source, t, length = _HEADER.unpack_from(view, pos)
+            pos += _HEADER.size
+            if pos + length > end:
+                self.truncated = True     # cut short while the game was running
+                break
+            payload = view[pos:pos + length]
+            pos += length
+            if rtype == REC_SESSION:
+                session += 1
+                self.sessions.append({})
+            elif rtype == REC_SOURCE and session >= 0:
+                board, label = bytes(payload[1:]).decode().split("\0", 1)
+                self.sessions[session][source] = Source(payload[0], board, label)
+            yield session, Record(rtype, source, t, payload)
+
+    def close(self):
+        try:
+            self._map.close()
+        except BufferError:
+            pass    # a Record still holds a payload view; freed with it
+        self._file.close()
+
+
+def replay_boards(log):
+    """
+    Decode a recording the way GameManager reads it: the newest block of
+    each half, overlaid by partial channel scans, decoded as a pair with
+    decode_board() whenever either half changes. Yields
+    (session, board name, t, flat board, placement hash).
+    """
+    from manager import BLOCK_BYTES, decode_board
+
+    halves = {}
+    for session, rec in log:
+        if rec.type == REC_SESSION:
+            halves = {}
+            continue
+        if rec.type not in (REC_BLOCK, REC_CHANNELS):
+            continue
+        src = log.sessions[session].get(rec.source)
+        if src is None:
+            continue
+        pair = halves.setdefault(src.board, [None, None])
+        if rec.type == REC_BLOCK:
+            pair[src.half] = bytes(rec.payload)
+        else:
+            if pair[src.half] is None:
+                continue
+            (mask,) = _MASK.unpack_from(rec.payload)
+            block = bytearray(pair[src.half])
+            values = iter(rec.payload[_MASK.size:])
+            for ch in range(BLOCK_BYTES):
+                if (mask >> ch) & 1:
+                    block[ch] = next(values)
+            pair[src.half] = bytes(block)
+        decoded = decode_board(pair[0], pair[1])
+        if decoded is not None:
+            yield session, src.board, rec.t, decoded[0], decoded[1]
+
+
+def main(argv):
+    if not argv or argv[0].startswith("-"):
+        print("usage: python recorder.py FILE [--boards]")
+        return 2
+    log = RecordLog(argv[0])
+    try:
+        if "--boards" in argv[1:]:
+            from manager import ID_TO_SYMBOL
+            last = {}
+            for session, board, t, flat, h in replay_boards(log):
+                if last.get(board) == h:
+                    continue
+                last[board] = h
+                placement = "".join(ID_TO_SYMBOL.get(p, ".") for p in flat)
+                print(f"{session:3d} {board or '-':<10} {t:10.3f}  {h:016x}  {placement}")
+        else:
+            names = {REC_BLOCK: "blocks", REC_CHANNELS: "channel scans",
+                     REC_MOTION: "motion writes", REC_MOVE: "moves"}
+            counts, span = [], []
+            for session, rec in log:
+                if rec.type == REC_SESSION:
+                    counts.append(dict.fromkeys(names, 0))
+                    span.append(0.0)
+                elif rec.type in names:
+                    counts[session][rec.type] += 1
+                    span[session] = rec.t
+                    if rec.type == REC_MOVE:
+                        uci, side = bytes(rec.payload).decode().split("\0")
+                        print(f"{session:3d} {rec.t:10.3f}  {side:<8} {uci}")
+            for i, c in enumerate(counts):
+                nanos = ", ".join(s.label for s in log.sessions[i].values())
+                print(f"session {i}: {span[i]:.1f} s, {nanos or 'no Nanos'}; "
+                      + ", ".join(f"{n} {names[k]}" for k, n in c.items()))
+        if log.truncated:
+            print("(last record incomplete)")
+    finally:
+        log.close()
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main(sys.argv[1:]))
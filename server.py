@@ -0,0 +1,108 @@
+"""
+server.py — several boards from one process.
+
+Each board is a GameManager as in manager.py, but instead of one
+Stockfish per board they share an EnginePool (engine.py): computer moves
+go ahead of pondering, and boards at the same priority are served
+round-robin. They also share one MoveBook and one pool of reader
+threads, and every Nano is pinged by the single heartbeat thread in
+manager.py.
+
+Boards come from the `server:` section of config.yaml:
+
+    server:
+      engines: 2                      # Stockfish processes for all boards
+      boards:
+        - name: table1
+          nano0: A900DMBL             # USB serial numbers, as NANO*_SERIAL
+          nano1: 95635333231351B0D151
+        - name: table2
+          nano0: ...
+          nano1: ...
+
+Run with `python server.py`. `engine:` settings apply to every board;
+`threads` is per pool engine, so engines × threads should not exceed the
+cores available.
+"""
+
+import threading
+import time
+from concurrent.futures import ThreadPoolExecutor
+
+import console
+from engine import EnginePool, MoveBook, engine_options
+from manager import GameManager, GameStopped, config, engine_config, engine_path
+
+log = console.logger("server")
+
+DEFAULT_ENGINES = 2
+# How long Ctrl-C waits for the boards to leave their wait loops; a board
+# in the middle of a search or a motion batch is left behind (its thread
+# is a daemon)
+STOP_TIMEOUT_S = 5.0
+
+
+def load_boards(cfg):
+    boards = cfg.get("boards") or []
+    if not boards:
+        raise Exception("config.yaml needs server.boards to run server.py")
+    for i, b in enumerate(boards):
+        if "nano0" not in b or "nano1" not in b:
+            raise Exception(f"server.boards[{i}] needs nano0 and nano1 serial numbers")
+    return [(b.get("name") or f"board{i}", b["nano0"], b["nano1"]) for i, b in enumerate(boards)]
+
+
+def run_board(gm):
+    try:
+        gm.play()
+    except GameStopped:
+        log.info("[%s] stopped", gm.label)
+    except Exception as e:
+        log.error("[%s] stopped: %s", gm.label, e)
+
+
+def main():
+    server_cfg = config.get("server") or {}
+    boards = load_boards(server_cfg)
+
+    pool = EnginePool(engine_path, size=int(server_cfg.get("engines", DEFAULT_ENGINES)),
+                      options=engine_options(engine_config))
+    book = MoveBook.from_config(engine_config)
+    # Two reads in flight per board, one per Nano
+    io_pool = ThreadPoolExecutor(max_workers=2 * len(boards), thread_name_prefix="nano-io")
+
+    # Boards start side by side; each waits mostly on its Nanos booting
+    with ThreadPoolExecutor(max_workers=len(boards), thread_name_prefix="startup") as ex:
+        starting = [(name, ex.submit(GameManager, engine_path, engine_config,
+                                     nano_serials=(nano0, nano1), label=name,
+                                     pool=pool, book=book, io_pool=io_pool))
+                    for name, nano0, nano1 in boards]
+    games = []
+    for name, future in starting:
+        try:
+            games.append(future.result())
+        except Exception as e:
+            log.error("[%s] not started: %s", name, e)
+
+    threads = [threading.Thread(target=run_board, args=(gm,), name=gm.label, daemon=True)
+               for gm in games]
+    for t in threads:
+        t.start()
+    try:
+        for t in threads:
+            t.join()
+    finally:
+        for gm in games:
+            gm.stop()
+        deadline = time.monotonic() + STOP_TIMEOUT_S
+        for t in threads:
+            t.join(max(0.0, deadline - time.monotonic()))
+        for gm in games:
+            gm.quit()
+        io_pool.shutdown(wait=False)
+        pool.close()
+        book.close()
+
+
+if __name__ == "__main__":
+    main()
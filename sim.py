@@ -0,0 +1,409 @@
+"""
+sim.py — a simulated board: both Nanos and the gantry, no hardware.
+
+SimRig holds the pieces (64 squares plus the graveyard) and two SimNano
+ports that speak the Nano side of the serial protocol (manager.py,
+protocol.py, motion.py) with configurable latency and noise:
+
+    CMD_PING, CMD_GET_BLOCK (raw), CMD_HELLO, CMD_GET_FRAME,
+    CMD_GET_CHANNELS, CMD_STREAM (pushes when a scan differs from the last push)
+    MOTION_BATCH, MOTION_MOVE_* (ASCII and binary), Nano0 only
+
+`caps` is what both Nanos list in their CMD_HELLO reply (Nano1 without
+the motion bits; 0 = legacy firmware, no reply). Commands outside it are
+not parsed, so their trailing bytes run as commands of their own, as on
+real legacy firmware.
+
+Every request takes `latency_ms` plus `scan_ms` per reader channel
+scanned. Each channel read misses (status bit clear) with probability
+`miss` and reports a wrong piece with probability `flicker`. Motion
+packets queue on the gantry and each takes the time motion.py's timing
+model gives it: the piece under the magnet leaves its square with the
+first step that carries it and lands when the magnet lets go (a
+magnet-off move, or the queue running empty), so reads and pushes see
+the board while it moves. A batch is acknowledged when its last step
+completes.
+
+    rig = SimRig(chess.Board())
+    gm = GameManager(None, ports=rig.ports, engine=IdleEngine())
+    rig.player_move(gm.board, chess.Move.from_uci("e2e4"))
+
+bench.py replays whole games this way.
+"""
+
+from __future__ import annotations
+
+import bisect
+import collections
+import itertools
+import random
+import struct
+import threading
+import time
+
+import chess
+
+from manager import (BLOCK_BYTES, CMD_GET_BLOCK, CMD_GET_CHANNELS, CMD_GET_FRAME, CMD_HELLO,
+                     CMD_PING, CMD_STREAM, EMPTY, ID_TO_SYMBOL, NANO0_SERIAL, NANO1_SERIAL,
+                     RAW_TO_SQUARE, board_placement, move_changes)
+from motion import (HOME_POS, MOTION_BATCH, MOTION_MOVE_ABS, MOTION_MOVE_ABS_BIN,
+                    MOTION_MOVE_REL, MOTION_MOVE_REL_BIN, MOTION_UNIT_MM, FLAG_MAG, Pos,
+                    pos_cell, segment_time)
+from protocol import (CAP_BATCH, CAP_BINARY, CAP_CHANNELS, CAP_FRAMED, CAP_STREAM, FRAME_BLOCK,
+                      FRAME_CAPS, FRAME_CHANNELS,
+                      FRAME_MOTION_DONE, MOTION_OK, encode_block_payload,
+                      encode_channels_payload, encode_frame)
+
+FULL_STATUS = (1 << BLOCK_BYTES) - 1
+_BIN_PACKET = struct.Struct("<BhhB")
+
+HAND_STEP_S = 0.25    # player: time between lifting and placing pieces
+
+
+class IdleEngine:
+    """Stands in for EnginePlayer when the computer's moves are scripted."""
+
+    def play(self, board):
+        raise RuntimeError("IdleEngine cannot search; pass the computer's moves yourself")
+
+    def start_ponder(self, board, expected_reply):
+        pass
+
+    def ponder_guess(self):
+        return None
+
+    def quit(self):
+        pass
+
+
+# --------------------------------------------------
+# SimRig — the pieces, shared by both ports
+# --------------------------------------------------
+class SimRig:
+    def __init__(self, board=None, latency_ms=2.0, scan_ms=1.0, flicker=0.0, miss=0.0,
+                 caps=CAP_FRAMED | CAP_CHANNELS | CAP_STREAM | CAP_BATCH | CAP_BINARY, seed=0):
+        self.squares = bytearray(board_placement(board if board is not None else chess.Board()))
+        self.offboard = {}             # graveyard cell (file < 0, rank) -> piece ID
+        self.latency_s = latency_ms / 1000.0
+        self.scan_s = scan_ms / 1000.0
+        self.flicker = flicker
+        self.miss = miss
+        self.caps = caps
+        self.rng = random.Random(seed)
+        self.lock = threading.Lock()
+
+        # Gantry: queued (completion time, target, magnet) steps, the head
+        # now and once the queue has run, and the piece on the magnet
+        self._gantry = collections.deque()
+        self._gantry_free = 0.0
+        self._planned_head = HOME_POS
+        self.head = HOME_POS
+        self._carrying = EMPTY
+
+        self.nano0 = SimNano(self, 0, motion=True)
+        self.nano1 = SimNano(self, 1)
+
+    @property
+    def ports(self):
+        return {NANO0_SERIAL: self.nano0, NANO1_SERIAL: self.nano1}
+
+    @property
+    def requests(self):
+        return self.nano0.requests + self.nano1.requests
+
+    @property
+    def pushes(self):
+        return self.nano0.pushes + self.nano1.pushes
+
+    def scan(self, half, channels):
+        """One scan of `channels` on a Nano: (status bitmap, {channel: value})."""
+        status, values = 0, {}
+        ids = list(ID_TO_SYMBOL)
+        with self.lock:
+            self._advance()
+            for ch in channels:
+                v = self.squares[RAW_TO_SQUARE[half * BLOCK_BYTES + ch]]
+                r = self.rng.random()
+                if r < self.miss:
+                    values[ch] = EMPTY
+                    continue
+                if r < self.miss + self.flicker:
+                    v = self.rng.choice(ids + [EMPTY])
+                status |= 1 << ch
+                values[ch] = v
+        return status, values
+
+    # --------------------------------------------------
+    # Gantry
+    # --------------------------------------------------
+    def queue_motion(self, packets):
+        """Queue decoded motion packets; returns when the last one completes."""
+        with self.lock:
+            self._advance()
+            t = max(time.monotonic(), self._gantry_free)
+            for p in packets:
+                absolute, x, y, mag = _decode_packet(p)
+                head = self._planned_head
+                target = (Pos(x + HOME_POS.x, y + HOME_POS.y) if absolute
+                          else Pos(head.x + x, head.y + y))
+                t += segment_time(target.x - head.x, target.y - head.y)
+                self._gantry.append((t, target, mag))
+                self._planned_head = target
+            self._gantry_free = t
+            return t
+
+    def _advance(self):
+        """Apply every gantry step completed by now (lock held)."""
+        now = time.monotonic()
+        while self._gantry and self._gantry[0][0] <= now:
+            _, target, mag = self._gantry.popleft()
+            if not mag:
+                self._drop()
+            elif self._carrying == EMPTY:
+                self._carrying = self._take(pos_cell(self.head))
+            self.head = target
+            if not self._gantry:
+                self._drop()
+
+    def _drop(self):
+        self._put(pos_cell(self.head), self._carrying)
+        self._carrying = EMPTY
+
+    # --------------------------------------------------
+    # Pieces (lock held)
+    # --------------------------------------------------
+    def _take(self, cell):
+        f, r = cell
+        if 0 <= f < 8 and 0 <= r < 8:
+            sq = chess.square(f, r)
+            pid, self.squares[sq] = self.squares[sq], EMPTY
+            return pid
+        return self.offboard.pop(cell, EMPTY)
+
+    def _put(self, cell, pid):
+        if pid == EMPTY:
+            return
+        f, r = cell
+        if 0 <= f < 8 and 0 <= r < 8:
+            self.squares[chess.square(f, r)] = pid
+        else:
+            self.offboard[cell] = pid
+
+    def set_square(self, sq, pid):
+        with self.lock:
+            self.squares[sq] = pid
+
+    def player_move(self, board, mv, hand_s=HAND_STEP_S):
+        """
+        Make `mv` by hand on the position `board`: lift every piece the
+        move takes away, then put down every piece it places, one square at
+        a time. Returns time.monotonic() when the last piece is down.
+        """
+        changes = move_changes(board, mv)
+        lifts = [sq for sq in changes if self.squares[sq] != EMPTY]
+        places = [sq for sq, pid in changes.items() if pid != EMPTY]
+        for sq in lifts:
+            self.set_square(sq, EMPTY)
+            time.sleep(hand_s)
+        for sq in places:
+            self.set_square(sq, changes[sq])
+            time.sleep(hand_s)
+        return time.monotonic() - hand_s
+
+
+# --------------------------------------------------
+# SimNano — one serial port
+# --------------------------------------------------
+class SimNano:
+    """SerialLike for Nano `half` of `rig`; Nano0 also runs the gantry."""
+
+    def __init__(self, rig, half, motion=False):
+        self.rig = rig
+        self.half = half
+        self.motion = motion
+        self.timeout = 1.0
+        self._in = bytearray()
+        self._out = bytearray()
+        self._pending = []             # (ready time, order, reply bytes), sorted
+        self._order = itertools.count()
+        self._busy_until = 0.0
+        self._lock = threading.Lock()
+
+        self.streaming = False
+        self._push_seq = 0
+        self._last_push = None
+        self._next_scan = 0.0
+
+        self.requests = 0
+        self.pushes = 0
+        self.channels_scanned = 0
+
+    # --------------------------------------------------
+    # SerialLike
+    # --------------------------------------------------
+    def write(self, data):
+        with self._lock:
+            self._in += data
+            self._handle()
+        return len(data)
+
+    def flush(self):
+        pass
+
+    def reset_input_buffer(self):
+        with self._lock:
+            self._pump()
+            self._out.clear()
+
+    @property
+    def in_waiting(self):
+        with self._lock:
+            self._pump()
+            return len(self._out)
+
+    def read(self, n=1):
+        deadline = time.monotonic() + (self.timeout or 0.0)
+        while True:
+            with self._lock:
+                self._pump()
+                if self._out:
+                    data = bytes(self._out[:n])
+                    del self._out[:n]
+                    return data
+                wake = min(self._pending[0][0], deadline) if self._pending else deadline
+            now = time.monotonic()
+            if now >= deadline:
+                return b""
+            time.sleep(max(0.0, min(wake, deadline, now + 0.002) - now))
+
+    def close(self):
+        pass
+
+    # --------------------------------------------------
+    # Firmware side
+    # --------------------------------------------------
+    def _reply(self, data, channels=0):
+        now = time.monotonic()
+        ready = max(now, self._busy_until) + self.rig.latency_s + channels * self.rig.scan_s
+        self._busy_until = ready
+        self._queue_reply(ready, data)
+
+    def _queue_reply(self, ready, data):
+        bisect.insort(self._pending, (ready, next(self._order), bytes(data)))
+
+    def _pump(self):
+        now = time.monotonic()
+        while self._pending and self._pending[0][0] <= now:
+            self._out += self._pending.pop(0)[2]
+        if self.streaming and now >= self._next_scan:
+            self._next_scan = now + BLOCK_BYTES * self.rig.scan_s
+            block = self._block_payload()
+            if block != self._last_push:
+                self._push(block)
+
+    def _block_payload(self):
+        status, values = self.rig.scan(self.half, range(BLOCK_BYTES))
+        self.channels_scanned += BLOCK_BYTES
+        return encode_block_payload(status, [values[ch] for ch in range(BLOCK_BYTES)])
+
+    def _push(self, payload):
+        self.pushes += 1
+        self._push_seq = (self._push_seq + 1) & 0xFF
+        self._last_push = payload
+        self._out += encode_frame(FRAME_BLOCK, self._push_seq, payload)
+
+    def _handle(self):
+        buf = self._in
+        caps = self.rig.caps if self.motion else self.rig.caps & ~(CAP_BATCH | CAP_BINARY)
+        while buf:
+            op = buf[0]
+            if op == CMD_PING:
+                self.requests += 1
+                self._reply(b"\x01")
+                del buf[:1]
+            elif op == CMD_GET_BLOCK:
+                self.requests += 1
+                status, values = self.rig.scan(self.half, range(BLOCK_BYTES))
+                self.channels_scanned += BLOCK_BYTES
+                self._reply(bytes(values[ch] for ch in range(BLOCK_BYTES)), BLOCK_BYTES)
+                del buf[:1]
+            elif op == CMD_HELLO:
+                if caps:
+                    self._reply(encode_frame(FRAME_CAPS, 0, bytes([caps])))
+                del buf[:1]
+            elif op == CMD_GET_FRAME and caps & CAP_FRAMED:
+                if len(buf) < 2:
+                    return
+                self.requests += 1
+                self._reply(encode_frame(FRAME_BLOCK, buf[1], self._block_payload()), BLOCK_BYTES)
+                del buf[:2]
+            elif op == CMD_GET_CHANNELS and caps & CAP_CHANNELS:
+                if len(buf) < 6:
+                    return
+                self.requests += 1
+                seq, mask = buf[1], int.from_bytes(buf[2:6], "little")
+                channels = [ch for ch in range(BLOCK_BYTES) if (mask >> ch) & 1]
+                status, values = self.rig.scan(self.half, channels)
+                self.channels_scanned += len(channels)
+                payload = encode_channels_payload(mask, status, [values[ch] for ch in channels])
+                self._reply(encode_frame(FRAME_CHANNELS, seq, payload), len(channels))
+                del buf[:6]
+            elif op == CMD_STREAM and caps & CAP_STREAM:
+                if len(buf) < 2:
+                    return
+                self.streaming = bool(buf[1])
+                if self.streaming:
+                    self._push(self._block_payload())
+                    self._next_scan = time.monotonic() + BLOCK_BYTES * self.rig.scan_s
+                del buf[:2]
+            elif self.motion and op == MOTION_BATCH and caps & CAP_BATCH:
+                if len(buf) < 3:
+                    return
+                packets, used = self._split_packets(buf, 3, buf[2])
+                if packets is None:
+                    return
+                seq = buf[1]
+                del buf[:used]
+                # Acknowledged once the gantry is done; reads go on meanwhile
+                done = self.rig.queue_motion(packets)
+                self._queue_reply(done + self.rig.latency_s, encode_frame(
+                    FRAME_MOTION_DONE, seq, bytes([MOTION_OK, len(packets)])))
+            elif self.motion and (op in (MOTION_MOVE_ABS, MOTION_MOVE_REL)
+                                  or op in (MOTION_MOVE_ABS_BIN, MOTION_MOVE_REL_BIN)
+                                  and caps & CAP_BINARY):
+                packets, used = self._split_packets(buf, 0, 1)
+                if packets is None:
+                    return
+                del buf[:used]
+                self.rig.queue_motion(packets)
+            else:
+                del buf[:1]     # not a command this firmware knows
+
+    @staticmethod
+    def _split_packets(buf, start, count):
+        """Cut `count` motion packets from buf[start:]; (None, 0) if incomplete."""
+        packets, i = [], start
+        for _ in range(count):
+            if i >= len(buf):
+                return None, 0
+            if buf[i] in (MOTION_MOVE_ABS_BIN, MOTION_MOVE_REL_BIN):
+                end = i + _BIN_PACKET.size
+                if end > len(buf):
+                    return None, 0
+            else:
+                end = buf.find(b"\n", i)
+                if end < 0:
+                    return None, 0
+                end += 1
+            packets.append(bytes(buf[i:end]))
+            i = end
+        return packets, i
+
+
+def _decode_packet(p):
+    """A motion packet as (absolute, x mm, y mm, magnet)."""
+    if p[0] in (MOTION_MOVE_ABS_BIN, MOTION_MOVE_REL_BIN):
+        op, x, y, flags = _BIN_PACKET.unpack(p)
+        return op == MOTION_MOVE_ABS_BIN, x * MOTION_UNIT_MM, y * MOTION_UNIT_MM, flags & FLAG_MAG
+    x, y, mag = p[1:].decode().split()
+    return p[0] == MOTION_MOVE_ABS, float(x), float(y), int(mag)
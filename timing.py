@@ -0,0 +1,167 @@
+"""
+timing.py — spans, round-trip histograms and counters for the game loop.
+
+    with TRACER.span("detect"):          # one stage of a turn
+        ...
+
+    @TRACER.traced("verify")             # every call of a function
+    def wait_until_physical_matches(...): ...
+
+    TRACER.rtt("Nano0", seconds)         # one serial request/response
+    TRACER.count("Nano0.failures")
+
+Disabled (the default) every call is a flag check. Enabled from the
+`trace:` section of config.yaml:
+
+    trace:
+      path: trace.json       # written when the game ends
+      format: chrome         # chrome (chrome://tracing, Perfetto) or jsonl
+
+Spans are kept in a bounded buffer (MAX_EVENTS, oldest dropped), so a
+long game cannot grow memory without limit.
+"""
+
+from __future__ import annotations
+
+import collections
+import contextlib
+import functools
+import json
+import os
+import threading
+import time
+
+import console
+
+log = console.logger("timing")
+
+MAX_EVENTS = 200_000
+
+# Round-trip histogram buckets: upper bounds in ms, the last is open-ended
+RTT_BUCKETS_MS = (1, 2, 5, 10, 20, 50, 100, 200, 500, 1000)
+
+
+class Histogram:
+    def __init__(self, bounds=RTT_BUCKETS_MS):
+        self.bounds = bounds
+        self.buckets = [0] * (len(bounds) + 1)
+        self.count = 0
+        self.total = 0.0
+        self.max = 0.0
+
+    def add(self, ms):
+        i = 0
+        while i < len(self.bounds) and ms > self.bounds[i]:
+            i += 1
+        self.buckets[i] += 1
+        self.count += 1
+        self.total += ms
+        self.max = max(self.max, ms)
+
+    def to_dict(self):
+        labels = [f"<={b}ms" for b in self.bounds] + [f">{self.bounds[-1]}ms"]
+        return {"count": self.count,
+                "mean_ms": round(self.total / self.count, 3) if self.count else None,
+                "max_ms": round(self.max, 3),
+                "buckets": dict(zip(labels, self.buckets))}
+
+
+class Tracer:
+    def __init__(self):
+        self.enabled = False
+        self.path = None
+        self.format = "chrome"
+        self._lock = threading.Lock()
+        self._events = collections.deque(maxlen=MAX_EVENTS)
+        self._counters = collections.Counter()
+        self._rtt = {}
+        self._t0 = time.perf_counter()
+
+    def configure(self, cfg):
+        cfg = cfg or {}
+        self.path = cfg.get("path")
+        self.format = cfg.get("format", "chrome")
+        if self.format not in ("chrome", "jsonl"):
+            raise Exception(f"trace.format must be chrome or jsonl, got {self.format!r}")
+        self.enabled = self.path is not None
+
+    # --------------------------------------------------
+    # Recording
+    # --------------------------------------------------
+    def span(self, name, **args):
+        if not self.enabled:
+            return contextlib.nullcontext()
+        return self._span(name, args)
+
+    def traced(self, name):
+        """Decorator: record every call of the function as a span."""
+        def wrap(fn):
+            @functools.wraps(fn)
+            def inner(*a, **kw):
+                if not self.enabled:
+                    return fn(*a, **kw)
+                with self._span(name, {}):
+                    return fn(*a, **kw)
+            return inner
+        return wrap
+
+    @contextlib.contextmanager
+    def _span(self, name, args):
+        start = time.perf_counter()
+        try:
+            yield
+        finally:
+            end = time.perf_counter()
+            event = (name, start - self._t0, end - start, threading.get_ident(), args)
+            with self._lock:
+                self._events.append(event)
+
+    def rtt(self, label, seconds):
+        if not self.enabled:
+            return
+        with self._lock:
+            hist = self._rtt.get(label)
+            if hist is None:
+                hist = self._rtt[label] = Histogram()
+            hist.add(seconds * 1000.0)
+
+    def count(self, name, n=1):
+        if not self.enabled:
+            return
+        with self._lock:
+            self._counters[name] += n
+
+    # --------------------------------------------------
+    # Export
+    # --------------------------------------------------
+    def summary(self):
+        with self._lock:
+            return {"counters": dict(self._counters),
+                    "rtt": {label: h.to_dict() for label, h in self._rtt.items()}}
+
+    def export(self, path=None):
+        path = path or self.path
+        if not self.enabled or path is None:
+            return
+        with self._lock:
+            events = list(self._events)
+        summary = self.summary()
+
+        tmp = path + ".tmp"
+        with open(tmp, "w") as f:
+            if self.format == "chrome":
+                trace = [{"name": name, "ph": "X", "ts": round(start * 1e6, 1),
+                          "dur": round(dur * 1e6, 1), "pid": os.getpid(), "tid": tid,
+                          "args": args}
+                         for name, start, dur, tid, args in events]
+                json.dump({"traceEvents": trace, "otherData": summary}, f)
+            else:
+                for name, start, dur, tid, args in events:
+                    f.write(json.dumps({"span": name, "t": round(start, 6), "dur": round(dur, 6),
+                                        "thread": tid, **args}) + "\n")
+                f.write(json.dumps({"summary": summary}) + "\n")
+        os.replace(tmp, path)
+        log.info("[trace] %d spans written to %s", len(events), path)
+
+
+TRACER = Tracer()